@@ -0,0 +1,7 @@
+#ifndef _HOST_ADAFRUIT_SPIDEVICE_H_
+#define _HOST_ADAFRUIT_SPIDEVICE_H_
+
+// Adafruit_GFX.h includes the Adafruit BusIO headers for its OLED and TFT
+// classes, which the host build leaves out (host/bench_sources.py)
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+// The part of the Arduino-ESP32 core used by the host builds.
+//
+// The clock calls run on the fake clock of FakeHal.cpp, Serial writes to
+// stdout, the cycle counter runs on the host's monotonic clock and pins
+// only remember what was written to them (HostCore.cpp). Nothing here
+// talks to hardware.
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+
+#include "Print.h"
+#include "WString.h"
+
+using std::max;
+using std::min;
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *) (addr))
+#define pgm_read_word(addr) (*(const uint16_t *) (addr))
+#define pgm_read_dword(addr) (*(const uint32_t *) (addr))
+#define pgm_read_ptr(addr) (*(void *const *) (addr))
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(uint32_t us);
+inline void yield() {}
+
+// Inputs read back the last level written, LOW when never written: the
+// panel's BUSY line always reads idle
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+
+// C3 die temperature, a fixed room temperature reading
+float temperatureRead();
+
+// FreeRTOS task handles, as far as Metrics watches them
+typedef void *TaskHandle_t;
+inline uint32_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+  return 0;
+}
+
+class EspClass
+{
+public:
+  // Cycles of a 1 GHz counter on the host's monotonic clock, so times
+  // come out in host microseconds
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 1000; }
+  const char *getSdkVersion() { return "host"; }
+  uint32_t getFreeHeap() { return 0; }
+  uint32_t getMinFreeHeap() { return 0; }
+  uint32_t getMaxAllocHeap() { return 0; }
+};
+
+extern EspClass ESP;
+
+// Serial console on stdout
+class HostSerial : public Print
+{
+public:
+  void begin(unsigned long baud) {}
+  explicit operator bool() const { return true; }
+  size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+  size_t write(const uint8_t *buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+  using Print::write;
+  void flush() override { fflush(stdout); }
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _HOST_FS_H_
+#define _HOST_FS_H_
+
+#include <Arduino.h>
+
+// Declarations only: the host build includes the FileBrowser and ImageViewer
+// headers for their types, the card itself is never opened
+class File
+{
+public:
+  explicit operator bool() const { return false; }
+};
+
+#endif
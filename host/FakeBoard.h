@@ -0,0 +1,23 @@
+#ifndef _FAKE_BOARD_H_
+#define _FAKE_BOARD_H_
+
+#include <Arduino.h>
+
+// Test side of the host Hal (FakeHal.cpp): a clock that only moves when
+// told to, the USB sense line, and a record of the sleeps taken.
+//
+// Hal::delay() and Hal::lightSleep() advance the clock by the requested
+// time and return at once; light sleep leaves the awake clock (FreeRTOS
+// ticks on the device) where it was.
+namespace FakeBoard
+{
+// Back to time 0, USB unplugged, no sleeps
+void reset();
+void advance(uint32_t ms);
+void setUsb(bool connected);
+
+uint32_t lightSleeps();
+uint32_t lightSleptMs();
+}
+
+#endif
@@ -0,0 +1,28 @@
+#include "EventLog.h"
+
+// Host stand-in for the flash event log: events are counted and dropped
+
+static uint32_t g_logged = 0;
+
+void EventLog::begin()
+{
+}
+
+void EventLog::write(EventId id, int argc, const uint32_t *args)
+{
+  g_logged++;
+}
+
+uint32_t EventLog::pending()
+{
+  return 0;
+}
+
+void EventLog::flush()
+{
+}
+
+void EventLog::printStats(Print &out)
+{
+  out.printf("Event log: %u events, not persisted on the host\n", (unsigned) g_logged);
+}
@@ -0,0 +1,104 @@
+#include "FakeBoard.h"
+
+#include "Hal.h"
+
+static uint32_t g_nowMs = 0;
+static uint32_t g_awakeMs = 0;
+static bool g_usb = false;
+static uint32_t g_lightSleeps = 0;
+static uint32_t g_lightSleptMs = 0;
+
+void FakeBoard::reset()
+{
+  g_nowMs = 0;
+  g_awakeMs = 0;
+  g_usb = false;
+  g_lightSleeps = 0;
+  g_lightSleptMs = 0;
+}
+
+void FakeBoard::advance(uint32_t ms)
+{
+  g_nowMs += ms;
+  g_awakeMs += ms;
+}
+
+void FakeBoard::setUsb(bool connected)
+{
+  g_usb = connected;
+}
+
+uint32_t FakeBoard::lightSleeps()
+{
+  return g_lightSleeps;
+}
+
+uint32_t FakeBoard::lightSleptMs()
+{
+  return g_lightSleptMs;
+}
+
+uint32_t Hal::millis()
+{
+  return g_nowMs;
+}
+
+uint32_t Hal::micros()
+{
+  return g_nowMs * 1000;
+}
+
+void Hal::delay(uint32_t ms)
+{
+  FakeBoard::advance(ms);
+}
+
+uint32_t Hal::awakeMillis()
+{
+  return g_awakeMs;
+}
+
+int64_t Hal::rtcMicros()
+{
+  return (int64_t) g_nowMs * 1000;
+}
+
+bool Hal::usbConnected()
+{
+  return g_usb;
+}
+
+void Hal::lightSleep(uint32_t ms)
+{
+  g_nowMs += ms;
+  g_lightSleeps++;
+  g_lightSleptMs += ms;
+}
+
+void Hal::deepSleep()
+{
+  // The UI logic powers down through UiSink::deepSleep(), only the firmware
+  // calls this
+  fprintf(stderr, "Hal::deepSleep() on the host\n");
+  abort();
+}
+
+bool Hal::wokeByButton()
+{
+  return false;
+}
+
+unsigned long millis()
+{
+  return Hal::millis();
+}
+
+unsigned long micros()
+{
+  return Hal::micros();
+}
+
+void delay(unsigned long ms)
+{
+  Hal::delay(ms);
+}
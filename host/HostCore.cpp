@@ -0,0 +1,42 @@
+#include <Arduino.h>
+#include <SPI.h>
+#include <chrono>
+
+HostSerial Serial;
+EspClass ESP;
+SPIClass SPI;
+
+static uint8_t g_pinLevels[64];
+
+uint32_t EspClass::getCycleCount()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  // Below the fake clock's resolution
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+  if (pin < sizeof(g_pinLevels))
+  {
+    g_pinLevels[pin] = level;
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  return pin < sizeof(g_pinLevels) ? g_pinLevels[pin] : LOW;
+}
+
+float temperatureRead()
+{
+  return 33; // 25 C once X4Panel takes off the die offset
+}
@@ -0,0 +1,88 @@
+#ifndef _HOST_INPUT_MANAGER_H_
+#define _HOST_INPUT_MANAGER_H_
+
+#include <Arduino.h>
+#include <vector>
+
+#include "Hal.h"
+
+// Fake of the SDK's InputManager with the same interface, driven by a test
+// script instead of the ADC ladder.
+//
+// The script is a list of button masks held from a given time on. Like the
+// real ladder, update() samples the buttons held at that moment and reports
+// the edges since the previous sample: a tap that starts and ends between
+// two samples is never seen.
+class InputManager
+{
+public:
+  static constexpr uint8_t BTN_BACK = 0;
+  static constexpr uint8_t BTN_CONFIRM = 1;
+  static constexpr uint8_t BTN_LEFT = 2;
+  static constexpr uint8_t BTN_RIGHT = 3;
+  static constexpr uint8_t BTN_UP = 4;
+  static constexpr uint8_t BTN_DOWN = 5;
+  static constexpr uint8_t BTN_POWER = 6;
+  static constexpr int POWER_BUTTON_PIN = 3;
+
+  void begin() {}
+
+  // Test side: hold the buttons of mask from ms on, in time order
+  void at(uint32_t ms, uint8_t mask) { _script.push_back({ms, mask}); }
+  // Hold button for ms from start on
+  void hold(uint8_t button, uint32_t start, uint32_t ms)
+  {
+    at(start, 1 << button);
+    at(start + ms, 0);
+  }
+
+  uint8_t getState()
+  {
+    uint8_t mask = _state;
+    for (const Step &step : _script)
+    {
+      if (step.ms <= Hal::millis()) mask = step.mask;
+    }
+    return mask;
+  }
+  void update()
+  {
+    uint8_t next = getState();
+    _pressed = next & ~_state;
+    _released = _state & ~next;
+    if (_pressed)
+    {
+      _pressStart = Hal::millis();
+    }
+    _state = next;
+  }
+
+  bool isPressed(uint8_t button) const { return _state & (1 << button); }
+  bool wasPressed(uint8_t button) const { return _pressed & (1 << button); }
+  bool wasAnyPressed() const { return _pressed; }
+  bool wasReleased(uint8_t button) const { return _released & (1 << button); }
+  bool wasAnyReleased() const { return _released; }
+  unsigned long getHeldTime() const { return Hal::millis() - _pressStart; }
+  bool isPowerButtonPressed() const { return isPressed(BTN_POWER); }
+
+  static const char *getButtonName(uint8_t button)
+  {
+    static const char *const NAMES[] = {"Back", "Confirm", "Left", "Right", "Up", "Down", "Power"};
+    return button <= BTN_POWER ? NAMES[button] : "Unknown";
+  }
+
+private:
+  struct Step
+  {
+    uint32_t ms;
+    uint8_t mask;
+  };
+
+  std::vector<Step> _script;
+  uint8_t _state = 0;
+  uint8_t _pressed = 0;
+  uint8_t _released = 0;
+  uint32_t _pressStart = 0;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _HOST_SPI_H_
+#define _HOST_SPI_H_
+
+#include <Arduino.h>
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0
+#define SPI_MODE1 1
+#define SPI_MODE2 2
+#define SPI_MODE3 3
+
+class SPISettings
+{
+public:
+  SPISettings(uint32_t clock = 1000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0) : clock(clock) {}
+
+  uint32_t clock;
+};
+
+// SPI bus with nothing on it: writes are counted and dropped, reads return
+// 0xFF like an idle MISO line
+class SPIClass
+{
+public:
+  void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {}
+  void end() {}
+  void beginTransaction(SPISettings settings) {}
+  void endTransaction() {}
+
+  uint8_t transfer(uint8_t data)
+  {
+    _bytes++;
+    return 0xFF;
+  }
+  uint16_t transfer16(uint16_t data)
+  {
+    _bytes += 2;
+    return 0xFFFF;
+  }
+  void transfer(void *data, uint32_t size)
+  {
+    _bytes += size;
+    memset(data, 0xFF, size);
+  }
+  void writeBytes(const uint8_t *data, uint32_t size) { _bytes += size; }
+
+  // Bytes clocked since start
+  uint64_t bytes() const { return _bytes; }
+
+private:
+  uint64_t _bytes = 0;
+};
+
+extern SPIClass SPI;
+
+#endif
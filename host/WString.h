@@ -0,0 +1,40 @@
+#ifndef _HOST_WSTRING_H_
+#define _HOST_WSTRING_H_
+
+#include <stdio.h>
+#include <string>
+
+// Flash strings are plain strings on the host
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+// The Arduino String calls used by the libraries, over std::string
+class String
+{
+public:
+  String(const char *str = "") : _s(str ? str : "") {}
+  String(const __FlashStringHelper *str) : String(reinterpret_cast<const char *>(str)) {}
+  explicit String(char c) : _s(1, c) {}
+  explicit String(int n) : _s(std::to_string(n)) {}
+  explicit String(unsigned int n) : _s(std::to_string(n)) {}
+  explicit String(long n) : _s(std::to_string(n)) {}
+  explicit String(unsigned long n) : _s(std::to_string(n)) {}
+
+  const char *c_str() const { return _s.c_str(); }
+  unsigned int length() const { return _s.length(); }
+  char operator[](unsigned int i) const { return i < _s.length() ? _s[i] : 0; }
+
+  String &operator+=(const String &other)
+  {
+    _s += other._s;
+    return *this;
+  }
+  friend String operator+(String a, const String &b) { return a += b; }
+  bool operator==(const String &other) const { return _s == other._s; }
+  bool operator!=(const String &other) const { return _s != other._s; }
+
+private:
+  std::string _s;
+};
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _HOST_AVR_PGMSPACE_H_
+#define _HOST_AVR_PGMSPACE_H_
+
+// GxEPD2 includes this outside ESP8266/ESP32 builds; program memory is
+// plain memory on the host (see Arduino.h)
+#include <Arduino.h>
+
+#endif
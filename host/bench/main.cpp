@@ -0,0 +1,71 @@
+// Host run of the drawing benchmark: the same cases as the "bench" serial
+// command, against the GxEPD2 frame buffer in memory, printing the same
+// JSON line for tools/bench_compare.py. Panel writes go to an SPI bus with
+// nothing on it and BUSY always reads idle.
+//
+//   platformio run -e native_bench
+//   .pio/build/native_bench/program [refresh] > host.log
+//
+// Times are host microseconds: compare host runs with host runs.
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#include "Arena.h"
+#include "Benchmark.h"
+#include "Display.h"
+#include "Layout.h"
+#include "Screens.h"
+
+DisplayType display(DisplayPanel(21, 4, 5, 6));
+
+static StaticArena<1024> g_frameArena("frame");
+static UiSnapshot g_snapshot;
+
+// A typical welcome screen: on battery, a page of the file list
+static void fillSnapshot(UiSnapshot &snap)
+{
+  static const char *const NAMES[FILE_LINES] = {"images", "books", "IMG_0001.x4i", "IMG_0002.x4i",
+                                                "a_file_name_long_enough_to_be_truncated.txt"};
+  memset(&snap, 0, sizeof(snap));
+  snap.command = DISPLAY_BENCHMARK;
+  snap.batteryRawMv = 1950;
+  snap.batteryVolts = 3.9f;
+  snap.batteryPercent = 72;
+  snap.sdReady = true;
+  snap.fileTotal = 42;
+  snap.fileCount = FILE_LINES;
+  for (int i = 0; i < FILE_LINES; i++)
+  {
+    snprintf(snap.files[i].name, sizeof(snap.files[i].name), "%s", NAMES[i]);
+    snap.files[i].flags = i < 2 ? FileBrowser::FLAG_DIR : 0;
+  }
+}
+
+static void drawBenchmarkScreen()
+{
+  g_frameArena.reset(); // Each iteration is a frame
+  Screens::drawInitial(g_snapshot, g_frameArena);
+}
+
+int main(int argc, char **argv)
+{
+  bool refresh = argc > 1 && strcmp(argv[1], "refresh") == 0;
+
+  fillSnapshot(g_snapshot);
+  display.init(0, true, 2, false, SPI, SPISettings(40000000, MSBFIRST, SPI_MODE0));
+  display.epd2.beginInstrumentation();
+  display.setRotation(Layout::ROTATION);
+  display.setTextColor(GxEPD_BLACK);
+
+  if (refresh)
+  {
+    Benchmark::runRefresh(Serial, drawBenchmarkScreen);
+  }
+  else
+  {
+    Benchmark::run(Serial, drawBenchmarkScreen);
+  }
+  Serial.flush();
+  return 0;
+}
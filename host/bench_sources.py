@@ -0,0 +1,20 @@
+# Build only the library sources the host benchmark links: the SSD1677 driver
+# and the GxEPD2 base from GxEPD2, and Adafruit_GFX.cpp from Adafruit GFX.
+# The other panel drivers and the OLED/TFT classes need the SPI, I2C and pin
+# APIs of real boards.
+import os
+
+Import("env")
+
+KEEP = ("GxEPD2_EPD.cpp", "GxEPD2_426_GDEQ0426T82.cpp", "Adafruit_GFX.cpp")
+LIBRARIES = ("/GxEPD2/", "/Adafruit GFX Library/")
+
+
+def bench_sources(env, node):
+    path = node.srcnode().get_path().replace("\\", "/")
+    if any(lib in path for lib in LIBRARIES) and os.path.basename(path) not in KEEP:
+        return None
+    return node
+
+
+env.AddBuildMiddleware(bench_sources)
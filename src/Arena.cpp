@@ -0,0 +1,47 @@
+#include "Arena.h"
+
+#include <stdarg.h>
+
+void *Arena::alloc(size_t size, size_t align)
+{
+  size_t start = (_used + align - 1) & ~(align - 1);
+  if (start + size > _size)
+  {
+    _failures++;
+    return nullptr;
+  }
+  _used = start + size;
+  return _buffer + start;
+}
+
+char *Arena::printf(const char *format, ...)
+{
+  // Format straight into the free tail, then commit what was used
+  size_t avail = _size - _used;
+  char *out = (char *) _buffer + _used;
+
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(out, avail, format, args);
+  va_end(args);
+
+  if (len < 0 || (size_t) len >= avail)
+  {
+    _failures++;
+    return nullptr;
+  }
+  _used += len + 1;
+  return out;
+}
+
+void Arena::reset()
+{
+  if (_used > _highWater) _highWater = _used;
+  _used = 0;
+}
+
+void Arena::printStats(Print &out) const
+{
+  out.printf("arena %s: %u / %u bytes at peak, %u failed allocations\n", _name,
+             (unsigned) (_highWater > _used ? _highWater : _used), (unsigned) _size, (unsigned) _failures);
+}
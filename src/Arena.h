@@ -0,0 +1,50 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <Arduino.h>
+
+// Bump allocator over a fixed buffer, for scratch memory that lives for one
+// frame.
+//
+// alloc() only advances an offset and reset() rewinds it, so per-frame
+// strings never reach the heap and cannot fragment it. An arena belongs to
+// one task; a failed allocation returns nullptr and is counted, callers fall
+// back to drawing without the scratch copy.
+class Arena
+{
+public:
+  Arena(const char *name, uint8_t *buffer, size_t size) : _name(name), _buffer(buffer), _size(size) {}
+
+  void *alloc(size_t size, size_t align = sizeof(void *));
+  // printf into the arena, returns nullptr when it does not fit
+  char *printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  // Release everything allocated since the last reset
+  void reset();
+
+  size_t used() const { return _used; }
+  size_t capacity() const { return _size; }
+  size_t highWater() const { return _highWater; }
+  uint32_t failures() const { return _failures; }
+  void printStats(Print &out) const;
+
+private:
+  const char *_name;
+  uint8_t *_buffer;
+  size_t _size;
+  size_t _used = 0;
+  size_t _highWater = 0;
+  uint32_t _failures = 0;
+};
+
+// Arena with its own static storage
+template <size_t N>
+class StaticArena : public Arena
+{
+public:
+  explicit StaticArena(const char *name) : Arena(name, _storage, N) {}
+
+private:
+  alignas(8) uint8_t _storage[N];
+};
+
+#endif
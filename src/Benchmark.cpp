@@ -0,0 +1,192 @@
+#include "Benchmark.h"
+
+#include <Fonts/FreeMonoBold12pt7b.h>
+#include <Fonts/FreeMonoBold18pt7b.h>
+
+#include "image.h"
+#include "Display.h"
+#include "Layout.h"
+#include "Metrics.h"
+
+static Print *g_out = nullptr;
+static void (*g_caseDone)() = nullptr;
+static bool g_firstResult = true;
+
+// Time `iterations` calls of fn with the cycle counter, print one JSON result
+template <typename Fn>
+static void measure(const char *name, int iterations, Fn fn)
+{
+  uint32_t minUs = UINT32_MAX;
+  uint32_t maxUs = 0;
+  uint64_t totalUs = 0;
+
+  for (int i = 0; i < iterations; i++)
+  {
+    uint32_t start = ESP.getCycleCount();
+    fn();
+    uint32_t us = Metrics::cyclesToMicros(ESP.getCycleCount() - start);
+    if (us < minUs) minUs = us;
+    if (us > maxUs) maxUs = us;
+    totalUs += us;
+  }
+
+  g_out->printf("%s{\"name\":\"%s\",\"iterations\":%d,\"min_us\":%u,\"mean_us\":%u,\"max_us\":%u}",
+                g_firstResult ? "" : ",", name, iterations, (unsigned) minUs, (unsigned) (totalUs / iterations),
+                (unsigned) maxUs);
+  g_firstResult = false;
+  if (g_caseDone)
+  {
+    g_caseDone();
+  }
+}
+
+static void printText(const GFXfont *font)
+{
+  display.setFont(font);
+  for (int line = 0; line < 10; line++)
+  {
+    display.setCursor(20, 60 + line * 60);
+    display.print("The quick brown fox");
+  }
+}
+
+static void begin(Print &out, void (*caseDone)())
+{
+  g_out = &out;
+  g_caseDone = caseDone;
+  g_firstResult = true;
+
+  out.printf("{\"benchmark\":{\"build\":\"%s %s\",\"sdk\":\"%s\",\"cpu_mhz\":%u},\"results\":[", __DATE__, __TIME__,
+             ESP.getSdkVersion(), (unsigned) ESP.getCpuFreqMHz());
+}
+
+static void end()
+{
+  g_out->println("]}");
+  g_out = nullptr;
+  g_caseDone = nullptr;
+}
+
+void Benchmark::run(Print &out, void (*drawInitial)(), void (*caseDone)())
+{
+  begin(out, caseDone);
+  // Every refresh below must really happen
+  bool autoRefresh = display.epd2.autoRefresh();
+  display.epd2.setAutoRefresh(false);
+
+  display.setFullWindow();
+
+  measure("fillScreen", 20, [] { display.fillScreen(GxEPD_WHITE); });
+
+  measure("drawBitmap_dr_mario", 20, [] {
+    display.drawBitmap(Layout::IMAGE.x, Layout::IMAGE.y, dr_mario, Layout::IMAGE.w, Layout::IMAGE.h, GxEPD_BLACK);
+  });
+
+  measure("text_FreeMonoBold12pt7b", 20, [] { printText(&FreeMonoBold12pt7b); });
+  measure("text_FreeMonoBold18pt7b", 20, [] { printText(&FreeMonoBold18pt7b); });
+
+  measure("setPartialWindow", 100, [] {
+    const Layout::Rect &w = Layout::TEXT_WINDOW;
+    display.setPartialWindow(w.x, w.y, w.w, w.h);
+  });
+  display.setFullWindow();
+
+  // Unchanged frame: one XOR per word
+  measure("frame_diff_same", 20, [] {
+    static FrameDiff::Result diff;
+    FrameDiff::compute(display.epd2.shadow(), display.epd2.shadow(), diff);
+  });
+
+  // Every pixel changed: popcount on every word. The inverted frame is
+  // static, a 48 KB heap block would be the largest allocation the firmware
+  // ever makes.
+  alignas(4) static uint8_t inverted[X4Panel::SHADOW_SIZE];
+  const uint8_t *shadow = display.epd2.shadow();
+  for (uint32_t i = 0; i < X4Panel::SHADOW_SIZE; i++)
+  {
+    inverted[i] = ~shadow[i];
+  }
+  measure("frame_diff_all", 20, [] {
+    static FrameDiff::Result diff;
+    FrameDiff::compute(display.epd2.shadow(), inverted, diff);
+  });
+
+  measure("initial_screen_draw", 10, [drawInitial] {
+    display.fillScreen(GxEPD_WHITE);
+    drawInitial();
+  });
+
+  measure("initial_screen_full", 1, [drawInitial] {
+    display.setFullWindow();
+    display.firstPage();
+    do
+    {
+      display.fillScreen(GxEPD_WHITE);
+      drawInitial();
+    } while (display.nextPage());
+  });
+
+  display.epd2.setAutoRefresh(autoRefresh);
+  end();
+}
+
+void Benchmark::runRefresh(Print &out, void (*drawInitial)(), void (*caseDone)())
+{
+  begin(out, caseDone);
+  bool autoRefresh = display.epd2.autoRefresh();
+  display.epd2.setAutoRefresh(false);
+
+  RefreshMode saved = display.epd2.refreshMode();
+  char name[40];
+  for (int mode = 0; mode < REFRESH_MODE_COUNT; mode++)
+  {
+    display.epd2.setRefreshMode((RefreshMode) mode);
+    const char *modeName = X4Panel::refreshModeName((RefreshMode) mode);
+
+    // Alternate black and white so every refresh changes all pixels
+    snprintf(name, sizeof(name), "refresh_%s_screen", modeName);
+    measure(name, 2, [] {
+      static bool black = false;
+      black = !black;
+      display.setFullWindow();
+      display.firstPage();
+      do
+      {
+        display.fillScreen(black ? GxEPD_BLACK : GxEPD_WHITE);
+      } while (display.nextPage());
+    });
+
+    if (mode == REFRESH_FULL || mode == REFRESH_FAST)
+    {
+      // Windows never flash: these modes refresh windows with PARTIAL
+      continue;
+    }
+    snprintf(name, sizeof(name), "refresh_%s_window", modeName);
+    measure(name, 2, [drawInitial] {
+      const Layout::Rect &w = Layout::TEXT_WINDOW;
+      display.setPartialWindow(w.x, w.y, w.w, w.h);
+      display.firstPage();
+      do
+      {
+        display.fillScreen(GxEPD_WHITE);
+        drawInitial();
+      } while (display.nextPage());
+    });
+  }
+
+  // Clear the ghosting left by the fast modes
+  display.epd2.setRefreshMode(REFRESH_FULL);
+  measure("refresh_full_initial_screen", 1, [drawInitial] {
+    display.setFullWindow();
+    display.firstPage();
+    do
+    {
+      display.fillScreen(GxEPD_WHITE);
+      drawInitial();
+    } while (display.nextPage());
+  });
+  display.epd2.setRefreshMode(saved);
+  display.epd2.setAutoRefresh(autoRefresh);
+
+  end();
+}
@@ -0,0 +1,26 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <Arduino.h>
+
+// On-device benchmark of the drawing primitives used by the firmware.
+//
+// Must run on the render task since it draws into the shared frame buffer.
+// Results are printed as a single JSON line starting with {"benchmark":
+// so they can be captured from the serial log and compared between builds
+// with tools/bench_compare.py.
+class Benchmark
+{
+public:
+  // drawInitial renders the DISPLAY_INITIAL screen into the frame buffer
+  // (without refreshing). The last case refreshes the panel with it, which
+  // also restores the screen. caseDone, when set, is called after every
+  // measured case, e.g. to keep a task heartbeat going.
+  static void run(Print &out, void (*drawInitial)(), void (*caseDone)() = nullptr);
+  // Time a whole-screen refresh in every waveform mode and a text-window
+  // refresh in the modes that have their own window waveform (PARTIAL, A2),
+  // ending with a full refresh of the DISPLAY_INITIAL screen
+  static void runRefresh(Print &out, void (*drawInitial)(), void (*caseDone)() = nullptr);
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef _DISPLAY_H_
+#define _DISPLAY_H_
+
+#include <GxEPD2_BW.h>
+
+#include "X4Panel.h"
+
+// GxEPD2 display - Using GxEPD2_426_GDEQ0426T82
+// Note: XteinkX4 has 4.26" 800x480 display, driven with a full-frame buffer
+typedef X4Panel DisplayPanel;
+typedef GxEPD2_BW<DisplayPanel, DisplayPanel::HEIGHT> DisplayType;
+
+extern DisplayType display;
+
+#endif
@@ -0,0 +1,292 @@
+#include "EventLog.h"
+
+#include <atomic>
+#include <esp_partition.h>
+#include <esp_system.h>
+
+#include "Hal.h"
+
+#define EVENTLOG_LABEL "eventlog"
+#define EVENTLOG_SUBTYPE ((esp_partition_subtype_t) 0x40)
+
+static const uint32_t SECTOR_SIZE = SPI_FLASH_SEC_SIZE;
+static const uint32_t SECTOR_MAGIC = 0x4C453458; // "X4EL" little endian
+static const uint32_t SECTOR_HEADER_SIZE = 16;
+
+struct SectorHeader
+{
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t startMs;
+  uint32_t reserved;
+};
+
+// Bounded MPSC ring (Vyukov): a slot is free for position p when its seq is
+// p, and holds a committed event when its seq is p + 1. The ESP32-C3 has no
+// atomic instruction extension, so compare-exchange goes through the IDF
+// helpers, which only mask interrupts for a few instructions.
+struct Slot
+{
+  std::atomic<uint32_t> seq;
+  uint32_t ms;
+  uint8_t id;
+  uint8_t argc;
+  uint32_t args[EventLog::MAX_ARGS];
+};
+
+static Slot g_slots[EventLog::SLOTS];
+static std::atomic<uint32_t> g_enqueuePos(0);
+static uint32_t g_dequeuePos = 0;
+static std::atomic<uint32_t> g_dropped(0);
+static bool g_ringReady = false;
+
+// Flash writer state, only touched by flush()
+static const esp_partition_t *g_partition = nullptr;
+static uint32_t g_sectorCount = 0;
+static uint32_t g_sector = 0;    // Current sector index
+static uint32_t g_sectorSeq = 0;
+static uint32_t g_offset = 0;    // Next write offset within the partition
+static uint32_t g_lastMs = 0;    // Timestamp of the last flushed record
+static uint32_t g_flushed = 0;
+
+static void initRing()
+{
+  for (uint32_t i = 0; i < EventLog::SLOTS; i++)
+  {
+    g_slots[i].seq.store(i, std::memory_order_relaxed);
+  }
+  g_ringReady = true;
+}
+
+void EventLog::write(EventId id, int argc, const uint32_t *args)
+{
+  if (!g_ringReady)
+  {
+    return;
+  }
+
+  uint32_t pos = g_enqueuePos.load(std::memory_order_relaxed);
+  Slot *slot;
+  for (;;)
+  {
+    slot = &g_slots[pos & (SLOTS - 1)];
+    int32_t diff = (int32_t) (slot->seq.load(std::memory_order_acquire) - pos);
+    if (diff == 0)
+    {
+      if (g_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      // Ring full: never block a hot path, count the loss instead
+      g_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    else
+    {
+      pos = g_enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->ms = Hal::millis();
+  slot->id = id;
+  slot->argc = argc;
+  for (int i = 0; i < argc; i++)
+  {
+    slot->args[i] = args[i];
+  }
+  slot->seq.store(pos + 1, std::memory_order_release);
+}
+
+uint32_t EventLog::pending()
+{
+  return g_enqueuePos.load(std::memory_order_relaxed) - g_dequeuePos;
+}
+
+static size_t putVarint(uint8_t *out, uint32_t v)
+{
+  size_t n = 0;
+  while (v >= 0x80)
+  {
+    out[n++] = (uint8_t) (v | 0x80);
+    v >>= 7;
+  }
+  out[n++] = (uint8_t) v;
+  return n;
+}
+
+static void openSector(uint32_t sector, uint32_t startMs)
+{
+  g_sector = sector;
+  g_sectorSeq++;
+  g_offset = sector * SECTOR_SIZE;
+  esp_partition_erase_range(g_partition, g_offset, SECTOR_SIZE);
+
+  SectorHeader header = {SECTOR_MAGIC, g_sectorSeq, startMs, 0xFFFFFFFF};
+  esp_partition_write(g_partition, g_offset, &header, sizeof(header));
+  g_offset += SECTOR_HEADER_SIZE;
+}
+
+// Find the end of the records in a sector: records always end with the last
+// byte of a varint (< 0x80), so the first erased byte after the last
+// non-0xFF byte is the append position
+static uint32_t findSectorEnd(uint32_t sector)
+{
+  uint8_t buf[256];
+  uint32_t base = sector * SECTOR_SIZE;
+  for (uint32_t chunk = SECTOR_SIZE; chunk > SECTOR_HEADER_SIZE; chunk -= sizeof(buf))
+  {
+    esp_partition_read(g_partition, base + chunk - sizeof(buf), buf, sizeof(buf));
+    for (int i = sizeof(buf) - 1; i >= 0; i--)
+    {
+      if (buf[i] != 0xFF)
+      {
+        uint32_t end = base + chunk - sizeof(buf) + i + 1;
+        return end < base + SECTOR_HEADER_SIZE ? base + SECTOR_HEADER_SIZE : end;
+      }
+    }
+  }
+  return base + SECTOR_HEADER_SIZE;
+}
+
+void EventLog::begin()
+{
+  initRing();
+
+  g_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, EVENTLOG_SUBTYPE, EVENTLOG_LABEL);
+  if (g_partition)
+  {
+    g_sectorCount = g_partition->size / SECTOR_SIZE;
+
+    // Resume in the sector with the highest sequence number
+    bool found = false;
+    for (uint32_t s = 0; s < g_sectorCount; s++)
+    {
+      SectorHeader header;
+      esp_partition_read(g_partition, s * SECTOR_SIZE, &header, sizeof(header));
+      if (header.magic == SECTOR_MAGIC && (!found || (int32_t) (header.seq - g_sectorSeq) > 0))
+      {
+        found = true;
+        g_sector = s;
+        g_sectorSeq = header.seq;
+      }
+    }
+
+    if (found)
+    {
+      g_offset = findSectorEnd(g_sector);
+    }
+    else
+    {
+      openSector(0, 0);
+    }
+  }
+
+  log(EVT_BOOT, esp_reset_reason(), esp_sleep_get_wakeup_cause());
+}
+
+void EventLog::flush()
+{
+  if (!g_partition)
+  {
+    // No partition: keep the ring from filling up
+    g_dequeuePos = g_enqueuePos.load(std::memory_order_relaxed);
+    return;
+  }
+
+  uint8_t staged[256];
+  size_t stagedLen = 0;
+  uint32_t stagedOffset = g_offset;
+
+  uint32_t dropped = g_dropped.exchange(0, std::memory_order_relaxed);
+  bool emitDropped = dropped > 0;
+
+  for (;;)
+  {
+    uint8_t id;
+    uint8_t argc;
+    uint32_t ms;
+    uint32_t args[MAX_ARGS];
+
+    if (emitDropped)
+    {
+      emitDropped = false;
+      id = EVT_LOG_DROPPED;
+      argc = 1;
+      ms = g_lastMs;
+      args[0] = dropped;
+    }
+    else
+    {
+      Slot &slot = g_slots[g_dequeuePos & (SLOTS - 1)];
+      if (slot.seq.load(std::memory_order_acquire) != g_dequeuePos + 1)
+      {
+        break;
+      }
+      id = slot.id;
+      argc = slot.argc;
+      ms = slot.ms;
+      for (int i = 0; i < argc; i++)
+      {
+        args[i] = slot.args[i];
+      }
+      slot.seq.store(g_dequeuePos + SLOTS, std::memory_order_release);
+      g_dequeuePos++;
+    }
+
+    // A boot restarts the clock, its delta is the absolute uptime
+    uint32_t dt = id == EVT_BOOT ? ms : ms - g_lastMs;
+    g_lastMs = ms;
+
+    uint8_t record[1 + 5 * (1 + MAX_ARGS)];
+    size_t len = 0;
+    record[len++] = id | (argc << 6);
+    len += putVarint(record + len, dt);
+    for (int i = 0; i < argc; i++)
+    {
+      len += putVarint(record + len, args[i]);
+    }
+
+    // Records never straddle sectors
+    uint32_t sectorEnd = (g_sector + 1) * SECTOR_SIZE;
+    if (g_offset + len > sectorEnd || stagedLen + len > sizeof(staged))
+    {
+      if (stagedLen)
+      {
+        esp_partition_write(g_partition, stagedOffset, staged, stagedLen);
+        stagedLen = 0;
+      }
+      if (g_offset + len > sectorEnd)
+      {
+        openSector((g_sector + 1) % g_sectorCount, id == EVT_BOOT ? 0 : ms - dt);
+      }
+      stagedOffset = g_offset;
+    }
+
+    memcpy(staged + stagedLen, record, len);
+    stagedLen += len;
+    g_offset += len;
+    g_flushed++;
+  }
+
+  if (stagedLen)
+  {
+    esp_partition_write(g_partition, stagedOffset, staged, stagedLen);
+  }
+}
+
+void EventLog::printStats(Print &out)
+{
+  if (!g_partition)
+  {
+    out.println("Event log: no '" EVENTLOG_LABEL "' partition, events are discarded");
+    return;
+  }
+  out.printf("Event log: sector %u/%u (seq %u), offset 0x%x, %u pending, %u flushed, %u dropped\n",
+             (unsigned) g_sector, (unsigned) g_sectorCount, (unsigned) g_sectorSeq, (unsigned) g_offset,
+             (unsigned) pending(), (unsigned) g_flushed, (unsigned) g_dropped.load());
+  out.printf("Dump with: esptool.py read_flash 0x%x 0x%x eventlog.bin\n", (unsigned) g_partition->address,
+             (unsigned) g_partition->size);
+}
@@ -0,0 +1,78 @@
+#ifndef _EVENT_LOG_H_
+#define _EVENT_LOG_H_
+
+#include <Arduino.h>
+
+// Structured binary event log.
+//
+// log() encodes an event into a fixed-size slot of a bounded lock-free MPSC
+// ring in RAM: no allocation, no serial I/O, safe from any task. flush()
+// drains the ring into the "eventlog" flash partition, where records are
+// appended as:
+//
+//   [id | argc << 6] [varint ms since previous record] [varint arg]...
+//
+// Each 4 KB flash sector starts with a 16 byte header (magic "X4EL",
+// sequence number, ms at sector start, reserved). tools/eventlog_decode.py
+// turns a partition dump back into text using the formats below.
+//
+// Event formats: the comment after each id is the decoder format string,
+// one {} per argument. Keep ids stable, they are stored in flash.
+enum EventId : uint8_t
+{
+  EVT_BOOT = 1,          // boot, reset reason {} wakeup cause {}
+  EVT_LOG_DROPPED = 2,   // {} events dropped, ring full
+  EVT_BUTTON_DOWN = 3,   // button {} down
+  EVT_BUTTON_UP = 4,     // button {} up after {} ms
+  EVT_RENDER_START = 5,  // render command {}
+  EVT_RENDER_END = 6,    // render command {} took {} ms
+  EVT_SD_MOUNT = 7,      // SD mount ok={}
+  EVT_IMAGE_SHOWN = 8,   // image {} shown, transfer {} ms refresh {} ms
+  EVT_SLEEP = 9,         // entering deep sleep after {} ms uptime
+  EVT_TASK_STALL = 10,   // task {} stalled for {} ms, recoverable={}
+  EVT_CRASH_RESET = 11,  // crash reset, reason {} count {} stalled task {}
+  EVT_COREDUMP = 12,     // core dump of {} bytes in flash
+  EVT_HEAP = 13,         // heap free {} min free {} largest block {}
+  EVT_POWER_STAGE = 14,  // power stage {} at {} mV after {} ms in the previous stage
+  EVT_COUNT
+};
+
+class EventLog
+{
+public:
+  static constexpr int SLOTS = 256;        // Power of two
+  static constexpr int MAX_ARGS = 3;
+
+  // Locate the flash partition and resume after the newest record
+  static void begin();
+
+  static void log(EventId id) { write(id, 0, nullptr); }
+  static void log(EventId id, uint32_t a)
+  {
+    uint32_t args[] = {a};
+    write(id, 1, args);
+  }
+  static void log(EventId id, uint32_t a, uint32_t b)
+  {
+    uint32_t args[] = {a, b};
+    write(id, 2, args);
+  }
+  static void log(EventId id, uint32_t a, uint32_t b, uint32_t c)
+  {
+    uint32_t args[] = {a, b, c};
+    write(id, 3, args);
+  }
+
+  // Number of events waiting in RAM
+  static uint32_t pending();
+  // Drain the RAM ring to flash. Flash writes stall the CPU cache, so call
+  // from an idle point (loop without input) and before deep sleep.
+  static void flush();
+
+  static void printStats(Print &out);
+
+private:
+  static void write(EventId id, int argc, const uint32_t *args);
+};
+
+#endif
@@ -0,0 +1,386 @@
+#include "FileBrowser.h"
+
+#include <SD.h>
+
+#include "Metrics.h"
+
+static const uint32_t INDEX_MAGIC = 0x58493458; // "X4IX" little endian
+static const uint16_t INDEX_VERSION = 2;
+
+struct IndexHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;
+  uint32_t count;
+  uint32_t signature;
+};
+
+static_assert(sizeof(IndexHeader) == 16, "index header layout");
+static_assert(sizeof(FileBrowser::Entry) == 64, "index record layout");
+
+// Directories first, then case-insensitive by name
+static int compareEntries(const FileBrowser::Entry &a, const FileBrowser::Entry &b)
+{
+  if ((a.flags ^ b.flags) & FileBrowser::FLAG_DIR)
+  {
+    return (a.flags & FileBrowser::FLAG_DIR) ? -1 : 1;
+  }
+  return strcasecmp(a.name, b.name);
+}
+
+static int compareEntriesQsort(const void *a, const void *b)
+{
+  return compareEntries(*(const FileBrowser::Entry *) a, *(const FileBrowser::Entry *) b);
+}
+
+// FNV-1a over the name, size and mtime of one entry; the signature is the sum
+// so it does not depend on directory order
+static uint32_t entryHash(const char *name, uint32_t size, uint32_t mtime)
+{
+  uint32_t h = 2166136261u;
+  for (const char *c = name; *c; c++)
+  {
+    h = (h ^ (uint8_t) *c) * 16777619u;
+  }
+  uint32_t words[2] = {size, mtime};
+  const uint8_t *bytes = (const uint8_t *) words;
+  for (size_t i = 0; i < sizeof(words); i++)
+  {
+    h = (h ^ bytes[i]) * 16777619u;
+  }
+  return h;
+}
+
+static bool readEntry(File &file, FileBrowser::Entry &entry)
+{
+  return file.read((uint8_t *) &entry, sizeof(entry)) == sizeof(entry);
+}
+
+void FileBrowser::path(char *out, const char *suffix) const
+{
+  // out must hold sizeof(_dir) + 16 bytes
+  const char *sep = strcmp(_dir, "/") == 0 ? "" : "/";
+  sprintf(out, "%s%s.x4index%s", _dir, sep, suffix);
+}
+
+bool FileBrowser::open(const char *dir)
+{
+  close();
+  strlcpy(_dir, dir, sizeof(_dir));
+
+  File d = SD.open(_dir);
+  if (!d || !d.isDirectory())
+  {
+    if (d) d.close();
+    return false;
+  }
+  d.close();
+
+  if (!openIndex())
+  {
+    startRebuild();
+  }
+  else if (openScan())
+  {
+    // Serve the index right away, rebuild it if the check finds a change
+    _state = STATE_CHECKING;
+  }
+  return true;
+}
+
+void FileBrowser::close()
+{
+  abortRebuild();
+  if (_index) _index.close();
+  _count = 0;
+}
+
+void FileBrowser::rebuild()
+{
+  if (_dir[0])
+  {
+    startRebuild();
+  }
+}
+
+bool FileBrowser::openIndex()
+{
+  char p[sizeof(_dir) + 16];
+  path(p, "");
+
+  if (_index) _index.close();
+  _count = 0;
+  _index = SD.open(p);
+  if (!_index)
+  {
+    return false;
+  }
+
+  IndexHeader header;
+  if (_index.read((uint8_t *) &header, sizeof(header)) != sizeof(header) || header.magic != INDEX_MAGIC ||
+      header.version != INDEX_VERSION || header.recordSize != sizeof(Entry))
+  {
+    _index.close();
+    return false;
+  }
+
+  _count = header.count;
+  _signature = header.signature;
+  return true;
+}
+
+int FileBrowser::read(uint32_t first, Entry *out, int n)
+{
+  if (!_index || first >= _count)
+  {
+    return 0;
+  }
+  if ((uint32_t) n > _count - first) n = _count - first;
+
+  _index.seek(sizeof(IndexHeader) + first * sizeof(Entry));
+  int bytes = _index.read((uint8_t *) out, n * sizeof(Entry));
+  return bytes / (int) sizeof(Entry);
+}
+
+bool FileBrowser::openScan()
+{
+  _scanDir = SD.open(_dir);
+  _scanned = 0;
+  _dirPos = 0;
+  _scanSum = 0;
+  return _scanDir;
+}
+
+void FileBrowser::startRebuild()
+{
+  abortRebuild();
+
+  char p[sizeof(_dir) + 16];
+  path(p, ".run0");
+  _runFile = SD.open(p, FILE_WRITE);
+  if (!openScan() || !_runFile)
+  {
+    abortRebuild();
+    return;
+  }
+  _state = STATE_SCANNING;
+}
+
+void FileBrowser::abortRebuild()
+{
+  if (_scanDir) _scanDir.close();
+  if (_runFile) _runFile.close();
+  closePass();
+  _state = STATE_IDLE;
+}
+
+bool FileBrowser::step()
+{
+  METRICS_SCOPE(METRIC_SD_SCAN);
+  switch (_state)
+  {
+  case STATE_CHECKING:
+    return checkStep();
+  case STATE_SCANNING:
+    return scanStep();
+  case STATE_MERGING:
+    return mergeStep();
+  default:
+    return false;
+  }
+}
+
+// Read the next RUN_ENTRIES visible directory entries into _run, adding them
+// to the signature. Fewer than RUN_ENTRIES means the directory is exhausted.
+int FileBrowser::readRun()
+{
+  int n = 0;
+  while (n < RUN_ENTRIES)
+  {
+    File f = _scanDir.openNextFile();
+    if (!f)
+    {
+      break;
+    }
+    _dirPos++;
+
+    const char *name = f.name();
+    const char *slash = strrchr(name, '/');
+    if (slash) name = slash + 1;
+
+    // Skip hidden entries, including the index files
+    if (name[0] != '.')
+    {
+      Entry &e = _run[n++];
+      memset(&e, 0, sizeof(e));
+      strlcpy(e.name, name, NAME_LEN);
+      e.flags = f.isDirectory() ? FLAG_DIR : 0;
+      e.size = e.flags ? 0 : f.size();
+      e.offset = _dirPos - 1;
+      _scanSum += entryHash(e.name, e.size, (uint32_t) f.getLastWrite());
+    }
+    f.close();
+  }
+  _scanned += n;
+  return n;
+}
+
+// Walk the directory like a scan, without writing, and rebuild the index
+// when the entries differ from the ones it was built from
+bool FileBrowser::checkStep()
+{
+  if (readRun() == RUN_ENTRIES)
+  {
+    return true;
+  }
+
+  _scanDir.close();
+  _state = STATE_IDLE;
+  if (_scanned != _count || _scanSum != _signature)
+  {
+    startRebuild();
+    return true;
+  }
+  return false;
+}
+
+// Read the next RUN_ENTRIES directory entries and append them as a sorted run
+bool FileBrowser::scanStep()
+{
+  int n = readRun();
+  qsort(_run, n, sizeof(Entry), compareEntriesQsort);
+  _runFile.write((const uint8_t *) _run, n * sizeof(Entry));
+
+  if (n < RUN_ENTRIES)
+  {
+    // Directory exhausted, runs of RUN_ENTRIES are ready to merge
+    _scanDir.close();
+    _runFile.close();
+    _runLength = RUN_ENTRIES;
+    _runSrc = 0;
+    _state = STATE_MERGING;
+  }
+  return true;
+}
+
+// Open the files of the next merge pass, which doubles the sorted run
+// length. The last pass writes the final index with its header.
+bool FileBrowser::openPass()
+{
+  bool last = _runLength * 2 >= _scanned;
+  char src[sizeof(_dir) + 16];
+  char dst[sizeof(_dir) + 16];
+  path(src, _runSrc ? ".run1" : ".run0");
+  path(dst, last ? ".new" : (_runSrc ? ".run0" : ".run1"));
+
+  _mergeA = SD.open(src);
+  _mergeB = SD.open(src);
+  _mergeOut = SD.open(dst, FILE_WRITE);
+  if (!_mergeA || !_mergeB || !_mergeOut)
+  {
+    return false;
+  }
+
+  if (last)
+  {
+    IndexHeader header = {INDEX_MAGIC, INDEX_VERSION, sizeof(Entry), _scanned, _scanSum};
+    _mergeOut.write((const uint8_t *) &header, sizeof(header));
+  }
+  _pairStart = 0;
+  startPair();
+  return true;
+}
+
+// Position the readers on the two runs starting at _pairStart
+void FileBrowser::startPair()
+{
+  uint32_t left = _scanned - _pairStart;
+  _aLeft = left < _runLength ? left : _runLength;
+  uint32_t bStart = _pairStart + _aLeft;
+  left = _scanned - bStart;
+  _bLeft = left < _runLength ? left : _runLength;
+
+  _mergeA.seek(_pairStart * sizeof(Entry));
+  _mergeB.seek(bStart * sizeof(Entry));
+  _hasA = _aLeft > 0 && readEntry(_mergeA, _run[0]);
+  _hasB = _bLeft > 0 && readEntry(_mergeB, _run[1]);
+}
+
+// Merge up to MERGE_RECORDS records of the current pass, opening it first
+bool FileBrowser::mergeStep()
+{
+  if (!_mergeOut && !openPass())
+  {
+    abortRebuild();
+    return false;
+  }
+
+  Entry &ea = _run[0];
+  Entry &eb = _run[1];
+  for (int i = 0; i < MERGE_RECORDS; i++)
+  {
+    if (!_hasA && !_hasB)
+    {
+      _pairStart += 2 * _runLength;
+      if (_pairStart >= _scanned)
+      {
+        return finishPass();
+      }
+      startPair();
+    }
+
+    if (_hasA && (!_hasB || compareEntries(ea, eb) <= 0))
+    {
+      _mergeOut.write((const uint8_t *) &ea, sizeof(ea));
+      _hasA = --_aLeft > 0 && readEntry(_mergeA, ea);
+    }
+    else
+    {
+      _mergeOut.write((const uint8_t *) &eb, sizeof(eb));
+      _hasB = --_bLeft > 0 && readEntry(_mergeB, eb);
+    }
+  }
+  return true;
+}
+
+bool FileBrowser::finishPass()
+{
+  bool last = _runLength * 2 >= _scanned;
+  closePass();
+  if (last)
+  {
+    finishRebuild();
+    return false;
+  }
+  _runLength *= 2;
+  _runSrc ^= 1;
+  return true;
+}
+
+void FileBrowser::closePass()
+{
+  if (_mergeA) _mergeA.close();
+  if (_mergeB) _mergeB.close();
+  if (_mergeOut) _mergeOut.close();
+}
+
+void FileBrowser::finishRebuild()
+{
+  char p[sizeof(_dir) + 16];
+  char next[sizeof(_dir) + 16];
+
+  if (_index) _index.close();
+  path(p, "");
+  path(next, ".new");
+  SD.remove(p);
+  SD.rename(next, p);
+
+  path(p, ".run0");
+  SD.remove(p);
+  path(p, ".run1");
+  SD.remove(p);
+
+  _state = STATE_IDLE;
+  openIndex();
+}
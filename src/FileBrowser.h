@@ -0,0 +1,114 @@
+#ifndef _FILE_BROWSER_H_
+#define _FILE_BROWSER_H_
+
+#include <Arduino.h>
+#include <FS.h>
+
+// Directory browser backed by a sorted on-card index.
+//
+// The index file (<dir>/.x4index) holds a 16 byte header followed by
+// fixed-size records sorted by name, so any window of entries is one seek
+// and one read regardless of folder size:
+//
+//   header: magic "X4IX", version, record size, entry count, signature
+//   record: name (NUL padded), size, offset (position in directory order),
+//           flags
+//
+// The signature sums a hash of every entry's name, size and mtime: FatFs
+// keeps no timestamp on the root directory, and a folder's own mtime does
+// not change when a file in it is rewritten. After open() the directory is
+// walked again in bounded steps to recompute it; when it or the count
+// differs from the index (or on request), the index is rebuilt in the
+// background with a bounded amount of work per step(): directory entries are
+// read in runs that are sorted in RAM, then merged pass by pass,
+// MERGE_RECORDS records per step. The previous index keeps serving windows
+// until the new one is renamed into place.
+class FileBrowser
+{
+public:
+  static constexpr int NAME_LEN = 52;
+  static constexpr int RUN_ENTRIES = 64;   // Entries sorted in RAM per step
+  static constexpr int MERGE_RECORDS = 64; // Records merged per step
+
+  struct Entry
+  {
+    char name[NAME_LEN];
+    uint32_t size;
+    uint32_t offset;
+    uint8_t flags;
+    uint8_t reserved[3];
+  };
+  static constexpr uint8_t FLAG_DIR = 0x01;
+
+  // Open the index of dir, schedules a rebuild if it is missing and a check
+  // for changes otherwise
+  bool open(const char *dir);
+  void close();
+  // Force a rebuild without waiting for the check
+  void rebuild();
+
+  // Do one bounded unit of index work, returns true while work remains
+  bool step();
+  bool busy() const { return _state != STATE_IDLE; }
+  // A rebuild is running, the listing will change when it is done
+  bool indexing() const { return _state == STATE_SCANNING || _state == STATE_MERGING; }
+  uint32_t indexedEntries() const { return _scanned; }
+
+  // Number of entries in the current index
+  uint32_t count() const { return _count; }
+  // Read up to n entries starting at first, returns the number read
+  int read(uint32_t first, Entry *out, int n);
+
+private:
+  enum State
+  {
+    STATE_IDLE = 0,
+    STATE_CHECKING,
+    STATE_SCANNING,
+    STATE_MERGING
+  };
+
+  void path(char *out, const char *suffix) const;
+  bool openIndex();
+  bool openScan();
+  int readRun();
+  void startRebuild();
+  bool checkStep();
+  bool scanStep();
+  bool mergeStep();
+  bool openPass();
+  void startPair();
+  bool finishPass();
+  void closePass();
+  void finishRebuild();
+  void abortRebuild();
+
+  char _dir[64] = "";
+  File _index;
+  uint32_t _count = 0;
+  uint32_t _signature = 0; // Of the current index
+
+  State _state = STATE_IDLE;
+  File _scanDir;
+  File _runFile;
+  uint32_t _scanned = 0;   // Entries read from the directory so far
+  uint32_t _dirPos = 0;    // Position in directory order, stored as offset
+  uint32_t _scanSum = 0;   // Signature of the entries read so far
+  uint32_t _runLength = 0; // Sorted run length of the current merge pass
+  uint8_t _runSrc = 0;     // Run file holding the input of the next pass
+
+  // Merge pass in progress: two readers on the source run file, one on each
+  // run of the current pair, and the destination; open between steps
+  File _mergeA;
+  File _mergeB;
+  File _mergeOut;
+  uint32_t _pairStart = 0; // First record of the current run pair
+  uint32_t _aLeft = 0;     // Records of each run not yet written,
+  uint32_t _bLeft = 0;     // including the head held in _run[0] / _run[1]
+  bool _hasA = false;
+  bool _hasB = false;
+  // Scan runs; while merging, [0] and [1] hold the heads of the two runs
+  Entry _run[RUN_ENTRIES];
+};
+
+#endif
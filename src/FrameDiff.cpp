@@ -0,0 +1,78 @@
+#include "FrameDiff.h"
+
+#include "Metrics.h"
+
+static const int ROW_WORDS = FrameDiff::FRAME_W / 32;
+static const int TILE_WORDS = FrameDiff::TILE_W / 32;
+
+static inline uint32_t load32(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+void FrameDiff::compute(const uint8_t *prev, const uint8_t *next, Result &out)
+{
+  uint32_t start = ESP.getCycleCount();
+  memset(&out, 0, sizeof(out));
+
+  // The GxEPD2 frame buffer has no alignment guarantee, misaligned word
+  // loads are split into byte loads by the compiler
+  bool aligned = (((uintptr_t) prev | (uintptr_t) next) & 3) == 0;
+  const uint32_t *a = (const uint32_t *) prev;
+  const uint32_t *b = (const uint32_t *) next;
+
+  for (int row = 0; row < FRAME_H; row++)
+  {
+    uint32_t *tiles = out.changed + row / TILE_H * COLS;
+    int base = row * ROW_WORDS;
+    for (int col = 0; col < COLS; col++)
+    {
+      uint32_t count = 0;
+      for (int i = base + col * TILE_WORDS; i < base + (col + 1) * TILE_WORDS; i++)
+      {
+        uint32_t x = aligned ? a[i] ^ b[i] : load32(prev + i * 4) ^ load32(next + i * 4);
+        if (x)
+        {
+          count += __builtin_popcount(x);
+        }
+      }
+      tiles[col] += count;
+    }
+  }
+
+  for (int t = 0; t < TILES; t++)
+  {
+    out.total += out.changed[t];
+    if (out.changed[t]) out.tileMask |= 1u << t;
+  }
+  out.micros = Metrics::cyclesToMicros(ESP.getCycleCount() - start);
+}
+
+bool FrameDiff::bounds(const Result &diff, int16_t &x, int16_t &y, int16_t &w, int16_t &h)
+{
+  if (!diff.tileMask)
+  {
+    return false;
+  }
+
+  int minCol = COLS, maxCol = -1, minRow = ROWS, maxRow = -1;
+  for (int t = 0; t < TILES; t++)
+  {
+    if (diff.tileMask & (1u << t))
+    {
+      int col = t % COLS;
+      int row = t / COLS;
+      if (col < minCol) minCol = col;
+      if (col > maxCol) maxCol = col;
+      if (row < minRow) minRow = row;
+      if (row > maxRow) maxRow = row;
+    }
+  }
+  x = minCol * TILE_W;
+  y = minRow * TILE_H;
+  w = (maxCol - minCol + 1) * TILE_W;
+  h = (maxRow - minRow + 1) * TILE_H;
+  return true;
+}
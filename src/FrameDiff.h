@@ -0,0 +1,41 @@
+#ifndef _FRAME_DIFF_H_
+#define _FRAME_DIFF_H_
+
+#include <Arduino.h>
+
+// Changed-pixel counts between two 1 bpp frames in native panel orientation
+// (800x480, rows of 100 bytes), per tile of a 5x5 grid.
+//
+// Frames are compared a 32-bit word at a time: XOR, then popcount only for
+// the words that differ, so an unchanged frame costs one load pair and a
+// branch per word.
+class FrameDiff
+{
+public:
+  static constexpr int16_t FRAME_W = 800;
+  static constexpr int16_t FRAME_H = 480;
+  static constexpr int16_t TILE_W = 160; // Multiple of 32 for whole words
+  static constexpr int16_t TILE_H = 96;
+  static constexpr int COLS = FRAME_W / TILE_W;
+  static constexpr int ROWS = FRAME_H / TILE_H;
+  static constexpr int TILES = COLS * ROWS;
+
+  struct Result
+  {
+    uint32_t changed[TILES]; // Changed pixels per tile, row-major
+    uint32_t total;
+    uint32_t tileMask;       // Bit i set when tile i changed
+    uint32_t micros;         // Time taken by compute()
+  };
+
+  static void compute(const uint8_t *prev, const uint8_t *next, Result &out);
+
+  // Native rectangle covering all changed tiles, false when nothing changed
+  static bool bounds(const Result &diff, int16_t &x, int16_t &y, int16_t &w, int16_t &h);
+};
+
+static_assert(FrameDiff::TILE_W % 32 == 0 && FrameDiff::FRAME_W % FrameDiff::TILE_W == 0 &&
+                FrameDiff::FRAME_H % FrameDiff::TILE_H == 0 && FrameDiff::TILES <= 32,
+              "tiles must split the frame into whole words and fit the tile mask");
+
+#endif
@@ -0,0 +1,172 @@
+#include "GestureEngine.h"
+
+// Repeats after which the step doubles, e.g. scrolling two then four pages
+#define REPEAT_ACCEL_1 8
+#define REPEAT_ACCEL_2 16
+#define REPEAT_INTERVAL_DECAY_MS 25
+
+void GestureEngine::setRepeat(uint8_t button, bool enabled)
+{
+  _repeatMask = enabled ? _repeatMask | mask(button) : _repeatMask & ~mask(button);
+}
+
+void GestureEngine::setMultiTap(uint8_t button, bool enabled)
+{
+  _multiTapMask = enabled ? _multiTapMask | mask(button) : _multiTapMask & ~mask(button);
+}
+
+bool GestureEngine::addChord(uint8_t chordMask)
+{
+  if (_chordCount >= MAX_CHORDS)
+  {
+    return false;
+  }
+  _chords[_chordCount++] = chordMask;
+  return true;
+}
+
+void GestureEngine::emit(GestureType type, uint8_t button, uint8_t count, uint32_t heldMs, uint8_t chordMask,
+                         uint8_t step)
+{
+  if ((uint8_t) (_head - _tail) >= QUEUE_SIZE)
+  {
+    _dropped++;
+    return;
+  }
+  _queue[_head++ & (QUEUE_SIZE - 1)] = {type, button, chordMask, count, step, heldMs};
+}
+
+bool GestureEngine::next(Gesture &gesture)
+{
+  if (_head == _tail)
+  {
+    return false;
+  }
+  gesture = _queue[_tail++ & (QUEUE_SIZE - 1)];
+  return true;
+}
+
+void GestureEngine::checkChords(uint32_t now)
+{
+  for (int i = 0; i < _chordCount; i++)
+  {
+    uint8_t chord = _chords[i];
+    uint32_t first = UINT32_MAX;
+    uint32_t last = 0;
+    bool allHeld = true;
+    bool busy = false; // A member already repeating or long-pressed
+    for (int b = 0; b < BUTTONS; b++)
+    {
+      if (!(chord & mask(b))) continue;
+      const ButtonState &st = _buttons[b];
+      if (!st.down)
+      {
+        allHeld = false;
+        break;
+      }
+      if (st.downMs < first) first = st.downMs;
+      if (st.downMs > last) last = st.downMs;
+      busy |= st.longFired || st.repeats > 0;
+    }
+
+    if (!allHeld)
+    {
+      _chordFired &= ~(1 << i);
+      continue;
+    }
+    if ((_chordFired & (1 << i)) || busy || last - first > CHORD_WINDOW_MS)
+    {
+      continue;
+    }
+
+    _chordFired |= 1 << i;
+    for (int b = 0; b < BUTTONS; b++)
+    {
+      if (chord & mask(b))
+      {
+        _buttons[b].consumed = true;
+        _buttons[b].taps = 0;
+      }
+    }
+    emit(GESTURE_CHORD, 0, 0, now - first, chord);
+  }
+}
+
+void GestureEngine::update(uint8_t pressed, uint8_t released, uint32_t now)
+{
+  for (int b = 0; b < BUTTONS; b++)
+  {
+    if (pressed & mask(b))
+    {
+      ButtonState &st = _buttons[b];
+      st.down = true;
+      st.consumed = false;
+      st.longFired = false;
+      st.repeats = 0;
+      st.downMs = now;
+      st.nextRepeatMs = now + REPEAT_DELAY_MS;
+      emit(GESTURE_PRESS, b);
+    }
+  }
+
+  checkChords(now);
+
+  for (int b = 0; b < BUTTONS; b++)
+  {
+    ButtonState &st = _buttons[b];
+    bool multiTap = _multiTapMask & mask(b);
+
+    if (st.down && (released & mask(b)))
+    {
+      uint32_t held = now - st.downMs;
+      st.down = false;
+      emit(GESTURE_RELEASE, b, st.repeats, held);
+
+      if (!st.consumed && !st.longFired && st.repeats == 0)
+      {
+        if (!multiTap)
+        {
+          emit(GESTURE_TAP, b, 1);
+        }
+        else if (st.taps < 255)
+        {
+          st.taps++;
+          st.lastTapMs = now;
+        }
+      }
+    }
+    else if (st.down && !st.consumed)
+    {
+      uint32_t held = now - st.downMs;
+      bool holding = ((_repeatMask & mask(b)) && (int32_t) (now - st.nextRepeatMs) >= 0) ||
+                     (!(_repeatMask & mask(b)) && !st.longFired && held >= LONG_PRESS_MS);
+      if (holding && st.taps)
+      {
+        // A hold ends the tap sequence before it
+        emit(GESTURE_TAP, b, st.taps);
+        st.taps = 0;
+      }
+
+      if (holding && (_repeatMask & mask(b)))
+      {
+        if (st.repeats < 255) st.repeats++;
+        uint8_t step = st.repeats >= REPEAT_ACCEL_2 ? 4 : st.repeats >= REPEAT_ACCEL_1 ? 2 : 1;
+        uint32_t decay = (uint32_t) st.repeats * REPEAT_INTERVAL_DECAY_MS;
+        uint32_t interval = decay + REPEAT_MIN_MS < REPEAT_START_MS ? REPEAT_START_MS - decay : REPEAT_MIN_MS;
+        st.nextRepeatMs = now + interval;
+        emit(GESTURE_REPEAT, b, st.repeats, held, 0, step);
+      }
+      else if (holding)
+      {
+        st.longFired = true;
+        emit(GESTURE_LONG_PRESS, b, 0, held);
+      }
+    }
+
+    if (!st.down && st.taps && now - st.lastTapMs > MULTI_TAP_MS)
+    {
+      emit(GESTURE_TAP, b, st.taps);
+      st.taps = 0;
+    }
+  }
+}
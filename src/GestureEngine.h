@@ -0,0 +1,102 @@
+#ifndef _GESTURE_ENGINE_H_
+#define _GESTURE_ENGINE_H_
+
+#include <Arduino.h>
+
+// Gesture layer over button edges.
+//
+// update() is called once per input poll with the buttons pressed and
+// released since the previous one (bit i for button i, as numbered by
+// InputManager) and turns those raw edges into gestures:
+//
+//   PRESS / RELEASE  every edge, RELEASE carries the hold time
+//   TAP              short press; buttons with multi-tap enabled report the
+//                    tap count once MULTI_TAP_MS passes without another tap
+//   LONG_PRESS       once per hold, after LONG_PRESS_MS
+//   REPEAT           auto-repeat while held, for buttons with repeat
+//                    enabled: the interval shrinks and the step grows the
+//                    longer the button is held
+//   CHORD            all buttons of a registered mask pressed together;
+//                    those buttons report no TAP, LONG_PRESS or REPEAT
+//                    until released
+//
+// Timing resolution is the poll period of the caller.
+enum GestureType : uint8_t
+{
+  GESTURE_PRESS = 0,
+  GESTURE_RELEASE,
+  GESTURE_TAP,
+  GESTURE_LONG_PRESS,
+  GESTURE_REPEAT,
+  GESTURE_CHORD
+};
+
+struct Gesture
+{
+  GestureType type;
+  uint8_t button;   // Unused for CHORD
+  uint8_t mask;     // CHORD: buttons in the chord
+  uint8_t count;    // TAP: taps, REPEAT: repeats so far, RELEASE: repeats fired
+  uint8_t step;     // REPEAT: accelerated step, 1 at first
+  uint32_t heldMs;  // RELEASE, LONG_PRESS, REPEAT: time held
+};
+
+class GestureEngine
+{
+public:
+  static constexpr int BUTTONS = 7;
+  static constexpr int MAX_CHORDS = 4;
+  static constexpr int QUEUE_SIZE = 16; // Power of two
+
+  static constexpr uint32_t LONG_PRESS_MS = 800;
+  static constexpr uint32_t MULTI_TAP_MS = 300;   // Max gap between taps
+  static constexpr uint32_t CHORD_WINDOW_MS = 150; // Max gap between chord presses
+  static constexpr uint32_t REPEAT_DELAY_MS = 400;
+  static constexpr uint32_t REPEAT_START_MS = 250; // First repeat interval
+  static constexpr uint32_t REPEAT_MIN_MS = 50;
+
+  static uint8_t mask(uint8_t button) { return 1 << button; }
+
+  void setRepeat(uint8_t button, bool enabled);
+  void setMultiTap(uint8_t button, bool enabled);
+  // Register a chord, returns false when the table is full
+  bool addChord(uint8_t mask);
+
+  void update(uint8_t pressed, uint8_t released, uint32_t now);
+  // Pop the next gesture, returns false when none is pending
+  bool next(Gesture &gesture);
+
+  // Gestures lost because the queue was full
+  uint32_t dropped() const { return _dropped; }
+
+private:
+  struct ButtonState
+  {
+    bool down;
+    bool consumed;   // Part of a fired chord, or long-pressed
+    bool longFired;
+    uint8_t repeats;
+    uint8_t taps;    // Pending multi-tap count
+    uint32_t downMs;
+    uint32_t nextRepeatMs;
+    uint32_t lastTapMs;
+  };
+
+  void emit(GestureType type, uint8_t button, uint8_t count = 0, uint32_t heldMs = 0, uint8_t mask = 0,
+            uint8_t step = 0);
+  void checkChords(uint32_t now);
+
+  ButtonState _buttons[BUTTONS] = {};
+  uint8_t _repeatMask = 0;
+  uint8_t _multiTapMask = 0;
+  uint8_t _chords[MAX_CHORDS] = {};
+  uint8_t _chordFired = 0; // Bit i set while chord i is held after firing
+  int _chordCount = 0;
+
+  Gesture _queue[QUEUE_SIZE];
+  uint8_t _head = 0;
+  uint8_t _tail = 0;
+  uint32_t _dropped = 0;
+};
+
+#endif
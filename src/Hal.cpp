@@ -0,0 +1,62 @@
+#include "Hal.h"
+
+#include <InputManager.h>
+#include <driver/gpio.h>
+#include <esp_sleep.h>
+#include <sys/time.h>
+
+#define UART0_RXD 20 // Used for USB connection detection
+
+uint32_t Hal::millis()
+{
+  return ::millis();
+}
+
+uint32_t Hal::micros()
+{
+  return ::micros();
+}
+
+void Hal::delay(uint32_t ms)
+{
+  ::delay(ms);
+}
+
+uint32_t Hal::awakeMillis()
+{
+  return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+int64_t Hal::rtcMicros()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+bool Hal::usbConnected()
+{
+  // U0RXD/GPIO20 reads HIGH when USB is connected
+  return digitalRead(UART0_RXD) == HIGH;
+}
+
+void Hal::lightSleep(uint32_t ms)
+{
+  esp_sleep_enable_timer_wakeup((uint64_t) ms * 1000);
+  gpio_wakeup_enable((gpio_num_t) InputManager::POWER_BUTTON_PIN, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  esp_light_sleep_start();
+}
+
+void Hal::deepSleep()
+{
+  // Wake on the power button only: the idle light sleep also armed the timer
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+  esp_deep_sleep_enable_gpio_wakeup(1ULL << InputManager::POWER_BUTTON_PIN, ESP_GPIO_WAKEUP_GPIO_LOW);
+  esp_deep_sleep_start();
+}
+
+bool Hal::wokeByButton()
+{
+  return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO;
+}
@@ -0,0 +1,37 @@
+#ifndef _HAL_H_
+#define _HAL_H_
+
+#include <Arduino.h>
+
+// Board services used by the input, power and sleep logic.
+//
+// All firmware code reads the clock and enters the sleep modes only
+// through these calls. The native build links host/FakeHal.cpp instead of
+// Hal.cpp: a clock that only moves when advanced, sleeps recorded instead
+// of taken (host/FakeBoard.h). Together with the scripted InputManager in
+// host/ and a UiSink, that drives UiController through button timelines.
+class Hal
+{
+public:
+  // Clock
+  static uint32_t millis();
+  static uint32_t micros();
+  static void delay(uint32_t ms);
+  // Milliseconds of FreeRTOS ticks, which stand still in light sleep like
+  // every task's timed wait
+  static uint32_t awakeMillis();
+  // Microseconds on the RTC timer, which keeps running in deep sleep
+  static int64_t rtcMicros();
+
+  // GPIO; buttons and battery ADC are read by InputManager and
+  // BatteryMonitor
+  static bool usbConnected();
+
+  // Sleep, both woken by the power button
+  static void lightSleep(uint32_t ms);
+  [[noreturn]] static void deepSleep();
+  // This boot is a wake-up from deep sleep by the power button
+  static bool wokeByButton();
+};
+
+#endif
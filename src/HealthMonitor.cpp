@@ -0,0 +1,234 @@
+#include "HealthMonitor.h"
+
+#include <esp_partition.h>
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+
+#include "EventLog.h"
+#include "Hal.h"
+
+#define MONITOR_TASK_STACK 3072 // Recover callbacks run on this stack
+#define MONITOR_PERIOD_MS 500
+// A task that stalls again within this window after a recovery escalates
+#define ESCALATE_WINDOW_MS 60000
+
+static const uint32_t RTC_MAGIC = 0x58344843; // "CH4X"
+static const uint8_t NO_STALL = 0xFF;
+
+struct WatchedTask
+{
+  const char *name;
+  uint32_t timeoutMs;
+  HealthMonitor::RecoverFn recover;
+  volatile uint32_t lastBeat;
+  uint32_t recoveries;
+  uint32_t lastRecovery;
+};
+
+// Survives panics, watchdog and software resets (not power loss)
+struct RtcState
+{
+  uint32_t magic;
+  uint32_t crashCount;
+  uint8_t lastStall; // Task index that forced the last restart
+  uint8_t stateValid;
+  uint8_t state[HealthMonitor::STATE_SIZE];
+  uint32_t checksum;
+};
+
+static RTC_NOINIT_ATTR RtcState g_rtc;
+
+static WatchedTask g_tasks[HealthMonitor::MAX_TASKS];
+static int g_taskCount = 0;
+static bool g_crashReset = false;
+static TaskHandle_t g_monitorHandle = NULL;
+
+static uint32_t rtcChecksum()
+{
+  const uint8_t *p = (const uint8_t *) &g_rtc;
+  uint32_t sum = 0x811C9DC5; // FNV-1a
+  for (size_t i = 0; i < offsetof(RtcState, checksum); i++)
+  {
+    sum = (sum ^ p[i]) * 0x01000193;
+  }
+  return sum;
+}
+
+static void restartSystem(int stalled)
+{
+  g_rtc.lastStall = stalled;
+  g_rtc.checksum = rtcChecksum();
+  esp_restart();
+}
+
+static void monitorTask(void *parameter)
+{
+  esp_task_wdt_add(NULL);
+
+  while (1)
+  {
+    esp_task_wdt_reset();
+
+    uint32_t now = Hal::awakeMillis();
+    for (int i = 0; i < g_taskCount; i++)
+    {
+      WatchedTask &t = g_tasks[i];
+      if (now - t.lastBeat <= t.timeoutMs)
+      {
+        continue;
+      }
+
+      bool canRecover = t.recover && (t.recoveries == 0 || now - t.lastRecovery > ESCALATE_WINDOW_MS);
+      EventLog::log(EVT_TASK_STALL, i, now - t.lastBeat, canRecover);
+      if (!canRecover)
+      {
+        restartSystem(i);
+      }
+
+      t.recoveries++;
+      t.lastRecovery = now;
+      t.recover();
+      t.lastBeat = Hal::awakeMillis();
+    }
+
+    vTaskDelay(MONITOR_PERIOD_MS / portTICK_PERIOD_MS);
+  }
+}
+
+void HealthMonitor::begin()
+{
+  esp_reset_reason_t reason = esp_reset_reason();
+  g_crashReset = reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT ||
+                 reason == ESP_RST_WDT || reason == ESP_RST_SW;
+
+  if (g_rtc.magic != RTC_MAGIC || g_rtc.checksum != rtcChecksum())
+  {
+    memset(&g_rtc, 0, sizeof(g_rtc));
+    g_rtc.magic = RTC_MAGIC;
+    g_rtc.lastStall = NO_STALL;
+    g_crashReset = false; // Nothing to restore
+  }
+
+  if (g_crashReset)
+  {
+    g_rtc.crashCount++;
+    EventLog::log(EVT_CRASH_RESET, reason, g_rtc.crashCount, g_rtc.lastStall);
+  }
+  g_rtc.lastStall = NO_STALL;
+  g_rtc.checksum = rtcChecksum();
+
+  uint32_t dumpSize = coreDumpSize();
+  if (dumpSize)
+  {
+    EventLog::log(EVT_COREDUMP, dumpSize);
+  }
+
+  // Reconfigures the watchdog if the core already started it
+  esp_task_wdt_init(WDT_TIMEOUT_S, true);
+  xTaskCreate(monitorTask, "HealthMonitor", MONITOR_TASK_STACK, NULL, configMAX_PRIORITIES - 2, &g_monitorHandle);
+}
+
+int HealthMonitor::add(const char *name, uint32_t timeoutMs, RecoverFn recover)
+{
+  if (g_taskCount >= MAX_TASKS)
+  {
+    return -1;
+  }
+  WatchedTask &t = g_tasks[g_taskCount];
+  t.name = name;
+  t.timeoutMs = timeoutMs;
+  t.recover = recover;
+  t.lastBeat = Hal::awakeMillis();
+  t.recoveries = 0;
+  t.lastRecovery = 0;
+  return g_taskCount++;
+}
+
+void HealthMonitor::beat(int id)
+{
+  if (id >= 0 && id < g_taskCount)
+  {
+    g_tasks[id].lastBeat = Hal::awakeMillis();
+  }
+}
+
+bool HealthMonitor::crashReset()
+{
+  return g_crashReset;
+}
+
+uint32_t HealthMonitor::crashCount()
+{
+  return g_rtc.crashCount;
+}
+
+void HealthMonitor::saveState(const void *state, size_t size)
+{
+  if (size > STATE_SIZE) size = STATE_SIZE;
+  memcpy(g_rtc.state, state, size);
+  g_rtc.stateValid = 1;
+  g_rtc.checksum = rtcChecksum();
+}
+
+bool HealthMonitor::loadState(void *state, size_t size)
+{
+  if (!g_rtc.stateValid || size > STATE_SIZE)
+  {
+    return false;
+  }
+  memcpy(state, g_rtc.state, size);
+  return true;
+}
+
+static const esp_partition_t *coreDumpPartition()
+{
+  return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_COREDUMP, NULL);
+}
+
+uint32_t HealthMonitor::coreDumpSize()
+{
+  // A flash core dump starts with its total length, erased flash reads 0xFFFFFFFF
+  const esp_partition_t *part = coreDumpPartition();
+  uint32_t size = 0;
+  if (!part || esp_partition_read(part, 0, &size, sizeof(size)) != ESP_OK || size == 0xFFFFFFFF ||
+      size > part->size)
+  {
+    return 0;
+  }
+  return size;
+}
+
+void HealthMonitor::eraseCoreDump()
+{
+  const esp_partition_t *part = coreDumpPartition();
+  if (part)
+  {
+    esp_partition_erase_range(part, 0, part->size);
+  }
+}
+
+void HealthMonitor::printStatus(Print &out)
+{
+  out.printf("Reset reason: %d, crash resets: %u%s\n", (int) esp_reset_reason(), (unsigned) g_rtc.crashCount,
+             g_crashReset ? " (restored last-known-good state)" : "");
+
+  uint32_t now = Hal::awakeMillis();
+  for (int i = 0; i < g_taskCount; i++)
+  {
+    const WatchedTask &t = g_tasks[i];
+    out.printf("  %-10s last beat %5u ms ago (timeout %u ms), %u recoveries\n", t.name,
+               (unsigned) (now - t.lastBeat), (unsigned) t.timeoutMs, (unsigned) t.recoveries);
+  }
+
+  const esp_partition_t *part = coreDumpPartition();
+  uint32_t dumpSize = coreDumpSize();
+  if (dumpSize)
+  {
+    out.printf("Core dump: %u bytes at 0x%x, decode with tools/coredump_decode.py\n", (unsigned) dumpSize,
+               (unsigned) part->address);
+  }
+  else
+  {
+    out.println("Core dump: none");
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef _HEALTH_MONITOR_H_
+#define _HEALTH_MONITOR_H_
+
+#include <Arduino.h>
+
+// Per-task heartbeats, subsystem restart and crash recovery.
+//
+// Each watched task calls beat() from its main loop. A small monitor task
+// checks the heartbeats and calls the task's recover callback when one goes
+// stale; tasks without a callback (or that stall again too soon) escalate to
+// a full restart. Staleness is measured in awake time: light sleep holds
+// every task's timed wait, so a heartbeat only ages while the chip runs.
+// The monitor task itself is guarded by the ESP task watchdog, which
+// panics, writes a core dump to the "coredump" partition and resets.
+//
+// A small application state blob is kept in RTC memory that survives
+// software resets, so the firmware can restore the last-known-good screen
+// instead of going through a cold boot after a crash.
+class HealthMonitor
+{
+public:
+  static constexpr int MAX_TASKS = 4;
+  static constexpr uint32_t WDT_TIMEOUT_S = 30;
+  static constexpr size_t STATE_SIZE = 16;
+
+  typedef void (*RecoverFn)();
+
+  // Start the monitor task and the task watchdog
+  static void begin();
+
+  // Watch a task, returns the id to pass to beat()
+  static int add(const char *name, uint32_t timeoutMs, RecoverFn recover);
+  static void beat(int id);
+
+  // True when the last reset was a panic, watchdog or restart by the monitor
+  static bool crashReset();
+  static uint32_t crashCount();
+
+  // Last-known-good application state kept across software resets
+  static void saveState(const void *state, size_t size);
+  static bool loadState(void *state, size_t size);
+
+  // Core dump partition holds a valid image (size in bytes, 0 if none)
+  static uint32_t coreDumpSize();
+  static void eraseCoreDump();
+
+  static void printStatus(Print &out);
+};
+
+#endif
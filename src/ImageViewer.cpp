@@ -0,0 +1,260 @@
+#include "ImageViewer.h"
+
+#include <SD.h>
+
+#include "Display.h"
+#include "Hal.h"
+#include "Metrics.h"
+
+static bool hasImageExtension(const char *name)
+{
+  size_t len = strlen(name);
+  size_t extLen = strlen(ImageViewer::IMAGE_EXT);
+  return len > extLen && strcasecmp(name + len - extLen, ImageViewer::IMAGE_EXT) == 0;
+}
+
+int ImageViewer::scan()
+{
+  METRICS_SCOPE(METRIC_SD_SCAN);
+  _count = 0;
+  File dir = SD.open(IMAGE_DIR);
+  if (!dir || !dir.isDirectory())
+  {
+    if (dir) dir.close();
+    return 0;
+  }
+
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+  {
+    if (!f.isDirectory() && hasImageExtension(f.name()))
+    {
+      _count++;
+    }
+    f.close();
+  }
+  dir.close();
+  return _count;
+}
+
+bool ImageViewer::openImage(int index, File &file)
+{
+  File dir = SD.open(IMAGE_DIR);
+  if (!dir || !dir.isDirectory())
+  {
+    if (dir) dir.close();
+    return false;
+  }
+
+  int i = 0;
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+  {
+    if (!f.isDirectory() && hasImageExtension(f.name()))
+    {
+      if (i++ == index)
+      {
+        const char *slash = strrchr(f.name(), '/');
+        strlcpy(_name, slash ? slash + 1 : f.name(), sizeof(_name));
+        file = f;
+        dir.close();
+        return true;
+      }
+    }
+    f.close();
+  }
+  dir.close();
+  return false;
+}
+
+bool ImageViewer::readHeader(File &file)
+{
+  uint8_t h[16];
+  if (file.read(h, sizeof(h)) != sizeof(h) || memcmp(h, "X4IM", 4) != 0 || h[4] != 1)
+  {
+    return false;
+  }
+
+  _bpp = h[5];
+  _compression = h[6];
+  _width = h[8] | (h[9] << 8);
+  _height = h[10] | (h[11] << 8);
+
+  // Frames are full-screen in native panel orientation only
+  if ((_bpp != 1 && _bpp != 2) || _compression > 1 || _width != DisplayPanel::WIDTH ||
+      _height != DisplayPanel::HEIGHT)
+  {
+    return false;
+  }
+
+  _inputPos = 0;
+  _inputLen = 0;
+  _runLeft = 0;
+  return true;
+}
+
+bool ImageViewer::fillInput(File &file)
+{
+  int n = file.read(_input, INPUT_BUFFER_SIZE);
+  if (n <= 0)
+  {
+    return false;
+  }
+  _inputPos = 0;
+  _inputLen = n;
+  _timing.bytesRead += n;
+  return true;
+}
+
+bool ImageViewer::readPayload(File &file, uint8_t *dst, size_t len)
+{
+  if (_compression == 0)
+  {
+    // Raw payload: read straight into the destination, no intermediate copy
+    size_t n = file.read(dst, len);
+    _timing.bytesRead += n;
+    return n == len;
+  }
+
+  // PackBits: control byte n < 128 copies n + 1 literals, n >= 128 repeats
+  // the next byte 257 - n times
+  while (len > 0)
+  {
+    if (_runLeft == 0)
+    {
+      if (_inputPos >= _inputLen && !fillInput(file)) return false;
+      uint8_t ctrl = _input[_inputPos++];
+      _runRepeat = ctrl >= 128;
+      _runLeft = _runRepeat ? 257 - ctrl : ctrl + 1;
+      if (_runRepeat)
+      {
+        if (_inputPos >= _inputLen && !fillInput(file)) return false;
+        _runValue = _input[_inputPos++];
+      }
+    }
+
+    size_t n = _runLeft < len ? _runLeft : len;
+    if (_runRepeat)
+    {
+      memset(dst, _runValue, n);
+    }
+    else
+    {
+      if (_inputPos >= _inputLen && !fillInput(file)) return false;
+      if (n > _inputLen - _inputPos) n = _inputLen - _inputPos;
+      memcpy(dst, _input + _inputPos, n);
+      _inputPos += n;
+    }
+    dst += n;
+    len -= n;
+    _runLeft -= n;
+  }
+  return true;
+}
+
+bool ImageViewer::readRows(File &file, uint8_t *dst, int rows)
+{
+  const size_t rowBytes = _width / 8;
+  if (_bpp == 1)
+  {
+    return readPayload(file, dst, rowBytes * rows);
+  }
+
+  // 2 bpp: keep the upper gray levels as white
+  for (int r = 0; r < rows; r++)
+  {
+    if (!readPayload(file, _row, rowBytes * 2)) return false;
+    for (size_t i = 0; i < rowBytes; i++)
+    {
+      uint8_t hi = _row[2 * i];
+      uint8_t lo = _row[2 * i + 1];
+      uint8_t out = 0;
+      for (int p = 0; p < 4; p++)
+      {
+        out = (out << 1) | ((hi >> (7 - 2 * p)) & 1);
+      }
+      for (int p = 0; p < 4; p++)
+      {
+        out = (out << 1) | ((lo >> (7 - 2 * p)) & 1);
+      }
+      *dst++ = out;
+    }
+  }
+  return true;
+}
+
+bool ImageViewer::show(int index, Mode mode)
+{
+  if (_count <= 0)
+  {
+    return false;
+  }
+  index %= _count;
+  if (index < 0) index += _count;
+
+  _timing = {};
+  unsigned long start = Hal::millis();
+
+  File file;
+  if (!openImage(index, file))
+  {
+    return false;
+  }
+  if (!readHeader(file))
+  {
+    file.close();
+    return false;
+  }
+
+  bool ok = true;
+  uint8_t rotation = display.getRotation();
+  if (mode == MODE_BUFFERED)
+  {
+    // Reference path: decode into the frame buffer through the GFX layer
+    display.setRotation(0);
+    display.setFullWindow();
+  }
+
+  // SD and panel share one SPI bus: alternate sector-aligned card reads with
+  // chunked panel RAM writes so only CHUNK_ROWS rows are ever held in RAM
+  for (int y = 0; ok && y < _height; y += CHUNK_ROWS)
+  {
+    int rows = _height - y < CHUNK_ROWS ? _height - y : CHUNK_ROWS;
+    ok = readRows(file, _chunk, rows);
+    if (!ok) break;
+
+    if (mode == MODE_STREAM)
+    {
+      display.epd2.writeImageForFullRefresh(_chunk, 0, y, _width, rows);
+    }
+    else
+    {
+      display.drawBitmap(0, y, _chunk, _width, rows, GxEPD_WHITE, GxEPD_BLACK);
+    }
+  }
+  file.close();
+  _timing.transferMs = Hal::millis() - start;
+
+  if (ok)
+  {
+    start = Hal::millis();
+    if (mode == MODE_STREAM)
+    {
+      display.epd2.refresh(false);
+    }
+    else
+    {
+      // Always a real refresh, as for the streamed chunks, so both paths
+      // time the same work
+      bool autoRefresh = display.epd2.autoRefresh();
+      display.epd2.setAutoRefresh(false);
+      display.display(false);
+      display.epd2.setAutoRefresh(autoRefresh);
+    }
+    _timing.refreshMs = Hal::millis() - start;
+  }
+
+  if (mode == MODE_BUFFERED)
+  {
+    display.setRotation(rotation);
+  }
+  return ok;
+}
@@ -0,0 +1,87 @@
+#ifndef _IMAGE_VIEWER_H_
+#define _IMAGE_VIEWER_H_
+
+#include <Arduino.h>
+#include <FS.h>
+
+// Full-screen viewer for pre-converted frames stored on the SD card.
+//
+// Files use the .x4i container written by tools/x4i_convert.py:
+//
+//   offset  size  field
+//   0       4     magic "X4IM"
+//   4       1     version (1)
+//   5       1     bits per pixel (1 or 2)
+//   6       1     compression (0 = raw, 1 = PackBits RLE)
+//   7       1     reserved
+//   8       2     width  (little endian, native panel orientation = 800)
+//   10      2     height (little endian, native panel orientation = 480)
+//   12      4     payload size in bytes (little endian)
+//
+// Pixels are stored MSB first in native panel orientation, 1 = white for
+// 1 bpp and 0 (black) .. 3 (white) for 2 bpp. 2 bpp frames are thresholded
+// to black/white while streaming since the panel is driven in BW mode.
+class ImageViewer
+{
+public:
+  enum Mode
+  {
+    MODE_STREAM = 0, // Decode in chunks straight into panel RAM
+    MODE_BUFFERED    // Decode into the display frame buffer first
+  };
+
+  struct Timing
+  {
+    unsigned long transferMs; // SD read + decode + panel RAM / buffer write
+    unsigned long refreshMs;  // Panel refresh
+    uint32_t bytesRead;       // Payload bytes read from the card
+  };
+
+  static constexpr const char *IMAGE_DIR = "/images";
+  static constexpr const char *IMAGE_EXT = ".x4i";
+
+  // Count the images available in IMAGE_DIR, returns the image count
+  int scan();
+  int count() const { return _count; }
+
+  // Show image at index (wrapped into [0, count)), returns false if the
+  // image cannot be opened or decoded
+  bool show(int index, Mode mode);
+
+  const Timing &lastTiming() const { return _timing; }
+  const char *lastName() const { return _name; }
+
+private:
+  static constexpr int CHUNK_ROWS = 40;
+  static constexpr int INPUT_BUFFER_SIZE = 2048; // Multiple of the SD sector size
+
+  bool openImage(int index, File &file);
+  bool readHeader(File &file);
+  bool readPayload(File &file, uint8_t *dst, size_t len);
+  bool readRows(File &file, uint8_t *dst, int rows);
+  bool fillInput(File &file);
+
+  int _count = 0;
+  char _name[64] = "";
+  Timing _timing = {};
+
+  // Current image header
+  uint8_t _bpp = 0;
+  uint8_t _compression = 0;
+  uint16_t _width = 0;
+  uint16_t _height = 0;
+
+  // Buffered reader / RLE decoder state
+  uint8_t _input[INPUT_BUFFER_SIZE];
+  size_t _inputPos = 0;
+  size_t _inputLen = 0;
+  uint16_t _runLeft = 0;     // Remaining bytes of the current run
+  bool _runRepeat = false;   // Current run repeats _runValue
+  uint8_t _runValue = 0;
+
+  // One chunk of 1 bpp output rows plus one 2 bpp source row
+  uint8_t _chunk[CHUNK_ROWS * (800 / 8)];
+  uint8_t _row[800 * 2 / 8];
+};
+
+#endif
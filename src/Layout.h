@@ -0,0 +1,145 @@
+#ifndef _LAYOUT_H_
+#define _LAYOUT_H_
+
+#include <stdint.h>
+
+#include "X4Panel.h"
+
+// Screen layout, described once as constexpr data.
+//
+// Text blocks are anchored at their first baseline; their bounding boxes,
+// the partial refresh windows covering them and the checks that they fit
+// the panel are all computed by the compiler, so drawing code and refresh
+// windows cannot drift apart and nothing is computed at runtime.
+//
+// Coordinates are in the rotated (portrait, rotation 3) frame. At rotation 3
+// the portrait y axis is the panel's native x axis, whose pixels are packed
+// 8 per byte: GxEPD2 silently widens a partial window to whole bytes, and
+// the widened strip gets cleared too, so windows are aligned here where
+// the overlap checks can see it.
+namespace Layout
+{
+constexpr int16_t ROTATION = 3;
+constexpr int16_t SCREEN_W = X4Panel::HEIGHT; // 480
+constexpr int16_t SCREEN_H = X4Panel::WIDTH;  // 800
+constexpr int16_t WINDOW_ALIGN = 8;           // Native x pixels per byte
+
+struct Rect
+{
+  int16_t x;
+  int16_t y;
+  int16_t w;
+  int16_t h;
+
+  constexpr int16_t right() const { return x + w; }
+  constexpr int16_t bottom() const { return y + h; }
+  constexpr bool fitsScreen() const
+  {
+    return x >= 0 && y >= 0 && w > 0 && h > 0 && right() <= SCREEN_W && bottom() <= SCREEN_H;
+  }
+  constexpr bool overlaps(const Rect &o) const
+  {
+    return x < o.right() && o.x < right() && y < o.bottom() && o.y < bottom();
+  }
+  constexpr bool contains(const Rect &o) const
+  {
+    return o.x >= x && o.y >= y && o.right() <= right() && o.bottom() <= bottom();
+  }
+};
+
+constexpr int16_t min16(int16_t a, int16_t b) { return a < b ? a : b; }
+constexpr int16_t max16(int16_t a, int16_t b) { return a > b ? a : b; }
+
+constexpr Rect unite(const Rect &a, const Rect &b)
+{
+  return {min16(a.x, b.x), min16(a.y, b.y), (int16_t) (max16(a.right(), b.right()) - min16(a.x, b.x)),
+          (int16_t) (max16(a.bottom(), b.bottom()) - min16(a.y, b.y))};
+}
+
+// Full-width window over a region, widened to whole bytes along the native x
+// axis exactly like GxEPD2 would
+constexpr Rect windowFor(const Rect &r)
+{
+  return {0, (int16_t) (r.y / WINDOW_ALIGN * WINDOW_ALIGN), SCREEN_W,
+          (int16_t) ((r.bottom() + WINDOW_ALIGN - 1) / WINDOW_ALIGN * WINDOW_ALIGN - r.y / WINDOW_ALIGN * WINDOW_ALIGN)};
+}
+
+// Vertical extent of a GFX font around the baseline, covering the tallest
+// glyphs (including descenders), and the fixed advance of the monospace fonts
+struct FontMetrics
+{
+  int16_t ascent;
+  int16_t descent;
+  int16_t advance;
+};
+
+constexpr FontMetrics MONO_BOLD_12 = {18, 6, 14}; // FreeMonoBold12pt7b
+constexpr FontMetrics MONO_BOLD_18 = {26, 8, 21}; // FreeMonoBold18pt7b
+
+// Lines of text: a title line at x, following lines at x + indent
+struct TextBlock
+{
+  int16_t x;
+  int16_t baseline; // First line
+  FontMetrics font;
+  int16_t lines;
+  int16_t lineHeight;
+  int16_t indent;
+
+  constexpr int16_t lineX(int line) const { return line ? x + indent : x; }
+  constexpr int16_t lineY(int line) const { return baseline + line * lineHeight; }
+  constexpr Rect bounds() const
+  {
+    return {x, (int16_t) (baseline - font.ascent), (int16_t) (SCREEN_W - x),
+            (int16_t) ((lines - 1) * lineHeight + font.ascent + font.descent)};
+  }
+  // Characters that fit on an indented line
+  constexpr int16_t maxChars() const { return (SCREEN_W - lineX(1)) / font.advance; }
+};
+
+// Main screen, top to bottom
+constexpr TextBlock HEADER = {20, 50, MONO_BOLD_18, 1, 0, 0};
+constexpr TextBlock BUTTONS = {20, 100, MONO_BOLD_12, 1, 0, 0};
+constexpr TextBlock BATTERY = {20, 160, MONO_BOLD_12, 4, 40, 20}; // Title, raw, volts, charge
+constexpr TextBlock FILES = {20, 324, MONO_BOLD_12, 6, 26, 20};   // Title, FILE_LINES entries
+
+constexpr int16_t IMAGE_MARGIN = 20;
+constexpr int16_t IMAGE_W = 263; // dr_mario
+constexpr int16_t IMAGE_H = 280;
+constexpr Rect IMAGE = {(int16_t) (SCREEN_W - IMAGE_MARGIN - IMAGE_W), (int16_t) (SCREEN_H - IMAGE_MARGIN - IMAGE_H),
+                        IMAGE_W, IMAGE_H};
+
+// Partial refresh windows of the main screen
+constexpr Rect TEXT_WINDOW = windowFor(unite(BUTTONS.bounds(), BATTERY.bounds()));
+constexpr Rect BATTERY_WINDOW = windowFor(BATTERY.bounds());
+constexpr Rect FILES_WINDOW = windowFor(FILES.bounds());
+
+// Single messages on full-screen pages
+constexpr TextBlock NO_IMAGES = {20, 380, MONO_BOLD_12, 1, 0, 0};
+constexpr TextBlock SLEEPING = {120, 380, MONO_BOLD_18, 1, 0, 0};
+
+static_assert(HEADER.bounds().fitsScreen() && BUTTONS.bounds().fitsScreen() && BATTERY.bounds().fitsScreen() &&
+                FILES.bounds().fitsScreen() && IMAGE.fitsScreen(),
+              "main screen regions must fit the rotated panel");
+static_assert(NO_IMAGES.bounds().fitsScreen() && SLEEPING.bounds().fitsScreen(), "messages must fit the rotated panel");
+
+// A window may only cover the regions redrawn with it
+static_assert(TEXT_WINDOW.fitsScreen() && !TEXT_WINDOW.overlaps(HEADER.bounds()) &&
+                !TEXT_WINDOW.overlaps(FILES.bounds()) && !TEXT_WINDOW.overlaps(IMAGE),
+              "text window clips a neighbouring region");
+static_assert(BATTERY_WINDOW.fitsScreen() && !BATTERY_WINDOW.overlaps(BUTTONS.bounds()) &&
+                !BATTERY_WINDOW.overlaps(FILES.bounds()),
+              "battery window clips a neighbouring region");
+static_assert(FILES_WINDOW.fitsScreen() && !FILES_WINDOW.overlaps(BATTERY.bounds()) &&
+                !FILES_WINDOW.overlaps(IMAGE),
+              "files window clips a neighbouring region");
+static_assert(TEXT_WINDOW.contains(BUTTONS.bounds()) && TEXT_WINDOW.contains(BATTERY.bounds()) &&
+                FILES_WINDOW.contains(FILES.bounds()),
+              "window misses part of its region");
+static_assert(TEXT_WINDOW.y % WINDOW_ALIGN == 0 && TEXT_WINDOW.h % WINDOW_ALIGN == 0 &&
+                BATTERY_WINDOW.y % WINDOW_ALIGN == 0 && BATTERY_WINDOW.h % WINDOW_ALIGN == 0 &&
+                FILES_WINDOW.y % WINDOW_ALIGN == 0 && FILES_WINDOW.h % WINDOW_ALIGN == 0,
+              "windows must be byte aligned on the native x axis");
+} // namespace Layout
+
+#endif
@@ -0,0 +1,160 @@
+#include "Metrics.h"
+
+static const char *const METRIC_NAMES[METRIC_COUNT] = {
+  "render.initial_us",
+  "render.text_us",
+  "render.battery_us",
+  "render.files_us",
+  "render.image_us",
+  "render.sleep_us",
+  "epd.refresh_us",
+  "epd.busy_us",
+  "epd.spi_bytes",
+  "sd.scan_us",
+  "epd.diff_us",
+};
+
+struct WatchedTask
+{
+  TaskHandle_t handle;
+  const char *name;
+  uint32_t stackSize;
+};
+
+static const int MAX_WATCHED_TASKS = 4;
+
+static Histogram g_histograms[METRIC_COUNT];
+static WatchedTask g_tasks[MAX_WATCHED_TASKS];
+static int g_taskCount = 0;
+
+static uint64_t g_spiBytesTotal = 0;
+static uint32_t g_renderSpiBytes = 0;
+static uint32_t g_renderBusyUs = 0;
+
+void Histogram::record(uint32_t value)
+{
+  if (count == 0 || value < min) min = value;
+  if (value > max) max = value;
+  count++;
+  sum += value;
+
+  int bucket = value ? 31 - __builtin_clz(value) : 0;
+  buckets[bucket]++;
+}
+
+void Histogram::reset()
+{
+  *this = Histogram();
+}
+
+uint32_t Histogram::percentile(uint8_t pct) const
+{
+  if (count == 0) return 0;
+
+  uint32_t target = ((uint64_t) count * pct + 99) / 100;
+  uint32_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++)
+  {
+    seen += buckets[i];
+    if (seen >= target)
+    {
+      uint32_t upper = i >= 31 ? UINT32_MAX : (2u << i) - 1;
+      return upper < max ? upper : max;
+    }
+  }
+  return max;
+}
+
+uint32_t Metrics::cyclesToMicros(uint32_t cycles)
+{
+  return cycles / ESP.getCpuFreqMHz();
+}
+
+uint8_t Metrics::heapFragmentation()
+{
+  // Share of free heap not usable by the largest single allocation
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (freeHeap == 0) return 100;
+  return 100 - (uint64_t) ESP.getMaxAllocHeap() * 100 / freeHeap;
+}
+
+void Metrics::record(MetricId id, uint32_t value)
+{
+  g_histograms[id].record(value);
+}
+
+void Metrics::addSpiBytes(uint32_t bytes)
+{
+  g_renderSpiBytes += bytes;
+  g_spiBytesTotal += bytes;
+}
+
+void Metrics::addBusyMicros(uint32_t us)
+{
+  g_renderBusyUs += us;
+}
+
+void Metrics::endRender()
+{
+  record(METRIC_SPI_BYTES, g_renderSpiBytes);
+  record(METRIC_BUSY_WAIT, g_renderBusyUs);
+  g_renderSpiBytes = 0;
+  g_renderBusyUs = 0;
+}
+
+void Metrics::watchTask(TaskHandle_t task, const char *name, uint32_t stackSize)
+{
+  if (!task)
+  {
+    return;
+  }
+
+  // A restarted task replaces its previous entry
+  for (int i = 0; i < g_taskCount; i++)
+  {
+    if (strcmp(g_tasks[i].name, name) == 0)
+    {
+      g_tasks[i] = {task, name, stackSize};
+      return;
+    }
+  }
+  if (g_taskCount < MAX_WATCHED_TASKS)
+  {
+    g_tasks[g_taskCount++] = {task, name, stackSize};
+  }
+}
+
+void Metrics::dump(Print &out)
+{
+  out.println("== Metrics ==");
+  out.printf("%-18s %8s %10s %10s %10s %10s %10s\n", "metric", "count", "min", "p50", "p90", "max", "mean");
+  for (int i = 0; i < METRIC_COUNT; i++)
+  {
+    const Histogram &h = g_histograms[i];
+    if (h.count == 0) continue;
+    out.printf("%-18s %8u %10u %10u %10u %10u %10u\n", METRIC_NAMES[i], (unsigned) h.count, (unsigned) h.min,
+               (unsigned) h.percentile(50), (unsigned) h.percentile(90), (unsigned) h.max,
+               (unsigned) (h.sum / h.count));
+  }
+
+  out.printf("epd.spi_bytes_total: %llu\n", (unsigned long long) g_spiBytesTotal);
+  out.printf("heap: free %u, min free %u, largest block %u, fragmentation %u%%\n", (unsigned) ESP.getFreeHeap(),
+             (unsigned) ESP.getMinFreeHeap(), (unsigned) ESP.getMaxAllocHeap(), (unsigned) heapFragmentation());
+
+  // ESP-IDF reports stack sizes and high-water marks in bytes
+  for (int i = 0; i < g_taskCount; i++)
+  {
+    uint32_t freeBytes = uxTaskGetStackHighWaterMark(g_tasks[i].handle);
+    out.printf("stack %s: %u / %u bytes used at peak\n", g_tasks[i].name,
+               (unsigned) (g_tasks[i].stackSize - freeBytes), (unsigned) g_tasks[i].stackSize);
+  }
+}
+
+void Metrics::reset()
+{
+  for (int i = 0; i < METRIC_COUNT; i++)
+  {
+    g_histograms[i].reset();
+  }
+  g_spiBytesTotal = 0;
+}
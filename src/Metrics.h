@@ -0,0 +1,97 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <Arduino.h>
+
+// Lightweight hot-path instrumentation.
+//
+// Samples are aggregated into fixed log2 histograms in RAM (no allocation),
+// and dumped on demand with the "metrics" serial command. Build with
+// -DMETRICS to enable; without it the METRICS_* macros compile to nothing.
+// Counters are updated without locking: a dump racing an update may be off by
+// one sample, which is fine for diagnostics.
+
+enum MetricId
+{
+  METRIC_RENDER_INITIAL = 0, // us per DisplayCommand render
+  METRIC_RENDER_TEXT,
+  METRIC_RENDER_BATTERY,
+  METRIC_RENDER_FILES,
+  METRIC_RENDER_IMAGE,
+  METRIC_RENDER_SLEEP,
+  METRIC_REFRESH,            // us per panel refresh
+  METRIC_BUSY_WAIT,          // us of BUSY wait per render
+  METRIC_SPI_BYTES,          // panel bytes sent per render
+  METRIC_SD_SCAN,            // us per SD directory scan
+  METRIC_FRAME_DIFF,         // us per whole-screen frame diff
+  METRIC_COUNT
+};
+
+class Histogram
+{
+public:
+  static constexpr int BUCKETS = 32; // Bucket i holds values in [2^i, 2^(i+1))
+
+  void record(uint32_t value);
+  void reset();
+  // Upper bound of the bucket holding the given percentile (0-100)
+  uint32_t percentile(uint8_t pct) const;
+
+  uint32_t count = 0;
+  uint32_t min = 0;
+  uint32_t max = 0;
+  uint64_t sum = 0;
+  uint32_t buckets[BUCKETS] = {};
+};
+
+class Metrics
+{
+public:
+  static void record(MetricId id, uint32_t value);
+
+  // Running totals for the render in progress
+  static void addSpiBytes(uint32_t bytes);
+  static void addBusyMicros(uint32_t us);
+  // Close the render in progress: records its SPI bytes and BUSY wait time
+  static void endRender();
+
+  // Track the stack high-water mark of a task (up to 4 tasks), an existing
+  // entry with the same name is replaced
+  static void watchTask(TaskHandle_t task, const char *name, uint32_t stackSize);
+
+  // Percentage of free heap outside the largest free block, 0 when unfragmented
+  static uint8_t heapFragmentation();
+
+  static void dump(Print &out);
+  static void reset();
+
+  static uint32_t cyclesToMicros(uint32_t cycles);
+};
+
+// Measures the lifetime of the scope with the CPU cycle counter
+class ScopedTimer
+{
+public:
+  explicit ScopedTimer(MetricId id) : _id(id), _start(ESP.getCycleCount()) {}
+  ~ScopedTimer() { Metrics::record(_id, Metrics::cyclesToMicros(ESP.getCycleCount() - _start)); }
+
+private:
+  MetricId _id;
+  uint32_t _start;
+};
+
+#ifdef METRICS
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+#define METRICS_SCOPE(id) ScopedTimer METRICS_CONCAT(_metricsScope, __LINE__)(id)
+#define METRICS_RECORD(id, value) Metrics::record(id, value)
+#define METRICS_SPI_BYTES(bytes) Metrics::addSpiBytes(bytes)
+#define METRICS_END_RENDER() Metrics::endRender()
+#else
+#define METRICS_SCOPE(id)
+#define METRICS_RECORD(id, value)
+#define METRICS_SPI_BYTES(bytes)
+#define METRICS_END_RENDER()
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+#include "PowerManager.h"
+
+#include "EventLog.h"
+#include "Hal.h"
+
+static const uint32_t RTC_MAGIC = 0x50344853; // "SH4P"
+
+static const char *const STAGE_NAMES[POWER_STAGE_COUNT] = {"active", "idle", "hibernate", "deep-sleep"};
+
+// Deep sleep entry, kept in RTC slow memory across the sleep (cleared by a
+// power loss)
+struct RtcSleep
+{
+  uint32_t magic;
+  uint16_t mv;
+  int64_t startUs;
+};
+
+static RTC_DATA_ATTR RtcSleep g_rtcSleep;
+
+const char *PowerManager::stageName(PowerStage stage)
+{
+  return stage < POWER_STAGE_COUNT ? STAGE_NAMES[stage] : "?";
+}
+
+bool PowerManager::begin(uint16_t batteryMv)
+{
+  uint32_t now = Hal::millis();
+  _lastActivity = now;
+  _stage = POWER_ACTIVE;
+  _stats[POWER_ACTIVE].entries = 1;
+  _stats[POWER_ACTIVE].enteredMs = now;
+  _stats[POWER_ACTIVE].enteredMv = batteryMv;
+
+  bool woke = g_rtcSleep.magic == RTC_MAGIC && Hal::wokeByButton();
+  g_rtcSleep.magic = 0;
+  if (!woke)
+  {
+    return false;
+  }
+
+  StageStats &sleep = _stats[POWER_DEEP_SLEEP];
+  uint32_t sleptMs = (Hal::rtcMicros() - g_rtcSleep.startUs) / 1000;
+  sleep.entries = 1;
+  sleep.enteredMs = 0; // Previous run
+  sleep.enteredMv = g_rtcSleep.mv;
+  sleep.totalMs = sleptMs;
+  sleep.totalMvDrop = (int32_t) g_rtcSleep.mv - batteryMv;
+  EventLog::log(EVT_POWER_STAGE, POWER_ACTIVE, batteryMv, sleptMs);
+  return true;
+}
+
+void PowerManager::setTimeouts(uint32_t idleMs, uint32_t hibernateMs, uint32_t sleepMs)
+{
+  _timeouts[POWER_IDLE] = idleMs;
+  _timeouts[POWER_HIBERNATE] = hibernateMs;
+  _timeouts[POWER_DEEP_SLEEP] = sleepMs;
+}
+
+void PowerManager::activity(uint32_t now)
+{
+  _lastActivity = now;
+}
+
+PowerStage PowerManager::target(uint32_t now) const
+{
+  uint32_t inactive = now - _lastActivity;
+  for (int stage = POWER_STAGE_COUNT - 1; stage > POWER_ACTIVE; stage--)
+  {
+    if (_timeouts[stage] && inactive >= _timeouts[stage])
+    {
+      return (PowerStage) stage;
+    }
+  }
+  return POWER_ACTIVE;
+}
+
+void PowerManager::enter(PowerStage stage, uint32_t now, uint16_t batteryMv)
+{
+  StageStats &from = _stats[_stage];
+  uint32_t spentMs = now - from.enteredMs;
+  from.totalMs += spentMs;
+  from.totalMvDrop += (int32_t) from.enteredMv - batteryMv;
+
+  StageStats &to = _stats[stage];
+  to.entries++;
+  to.enteredMs = now;
+  to.enteredMv = batteryMv;
+  _stage = stage;
+  EventLog::log(EVT_POWER_STAGE, stage, batteryMv, spentMs);
+
+  if (stage == POWER_DEEP_SLEEP)
+  {
+    g_rtcSleep.mv = batteryMv;
+    g_rtcSleep.startUs = Hal::rtcMicros();
+    g_rtcSleep.magic = RTC_MAGIC;
+  }
+}
+
+void PowerManager::printStatus(Print &out, uint32_t now) const
+{
+  out.printf("Power stage: %s, inactive for %u ms\n", stageName(_stage), (unsigned) (now - _lastActivity));
+  out.printf("Timeouts: idle %u ms, hibernate %u ms, deep sleep %u ms (0 = off)\n",
+             (unsigned) _timeouts[POWER_IDLE], (unsigned) _timeouts[POWER_HIBERNATE],
+             (unsigned) _timeouts[POWER_DEEP_SLEEP]);
+  for (int stage = 0; stage < POWER_STAGE_COUNT; stage++)
+  {
+    // Completed visits only: the battery reading of the current one is open
+    const StageStats &s = _stats[stage];
+    uint32_t mvPerHour = s.totalMs > 0 && s.totalMvDrop > 0 ? (uint64_t) s.totalMvDrop * 3600000 / s.totalMs : 0;
+    out.printf("  %-10s %4u entries, last at %8u ms %4u mV, %9u ms total, %5d mV lost, %4u mV/h\n",
+               stageName((PowerStage) stage), (unsigned) s.entries, (unsigned) s.enteredMs, (unsigned) s.enteredMv,
+               (unsigned) s.totalMs, (int) s.totalMvDrop, (unsigned) mvPerHour);
+  }
+}
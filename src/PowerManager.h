@@ -0,0 +1,63 @@
+#ifndef _POWER_MANAGER_H_
+#define _POWER_MANAGER_H_
+
+#include <Arduino.h>
+
+// Power stages entered one after the other while there is no user activity
+enum PowerStage : uint8_t
+{
+  POWER_ACTIVE = 0, // Normal polling
+  POWER_IDLE,       // I/O task light-sleeps between polls
+  POWER_HIBERNATE,  // Panel controller in deep sleep as well
+  POWER_DEEP_SLEEP, // Whole device off until the power button wakes it
+  POWER_STAGE_COUNT
+};
+
+// Inactivity timer with staged power states.
+//
+// Only decides and accounts: the firmware reports activity, asks target()
+// on every poll and performs the stage change itself before calling
+// enter(). Each entry records the time and battery voltage, so the time
+// spent and the voltage lost per stage show what every stage costs. Deep
+// sleep is accounted across the reset through RTC memory: begin() on the
+// following boot closes the stage.
+class PowerManager
+{
+public:
+  struct StageStats
+  {
+    uint32_t entries;
+    uint32_t enteredMs; // millis() at the last entry
+    uint16_t enteredMv; // Battery voltage at the last entry
+    uint32_t totalMs;   // Time spent in completed visits
+    int32_t totalMvDrop;
+  };
+
+  // Close the deep sleep of the previous run when waking from it, returns
+  // false on a cold boot
+  bool begin(uint16_t batteryMv);
+
+  // Time without activity before each stage, counted from the last
+  // activity; 0 skips the stage
+  void setTimeouts(uint32_t idleMs, uint32_t hibernateMs, uint32_t sleepMs);
+  void activity(uint32_t now);
+
+  // Stage the device should be in at now
+  PowerStage target(uint32_t now) const;
+  PowerStage stage() const { return _stage; }
+  // Record the change to stage, done by the caller. Entering deep sleep
+  // saves the record for begin().
+  void enter(PowerStage stage, uint32_t now, uint16_t batteryMv);
+
+  const StageStats &stats(PowerStage stage) const { return _stats[stage]; }
+  static const char *stageName(PowerStage stage);
+  void printStatus(Print &out, uint32_t now) const;
+
+private:
+  PowerStage _stage = POWER_ACTIVE;
+  uint32_t _lastActivity = 0;
+  uint32_t _timeouts[POWER_STAGE_COUNT] = {};
+  StageStats _stats[POWER_STAGE_COUNT] = {};
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "Screens.h"
+
+#include <Fonts/FreeMonoBold12pt7b.h>
+#include <Fonts/FreeMonoBold18pt7b.h>
+
+#include "image.h"
+#include "Display.h"
+#include "InputManager.h"
+#include "Layout.h"
+
+void Screens::drawBattery(const UiSnapshot &snap)
+{
+  const Layout::TextBlock &block = Layout::BATTERY;
+  display.setFont(&FreeMonoBold12pt7b);
+  display.setCursor(block.lineX(0), block.lineY(0));
+
+  display.printf("Power: %s", snap.charging ? "Charging" : "Battery");
+
+  display.setCursor(block.lineX(1), block.lineY(1));
+  display.printf("Raw: %i", snap.batteryRawMv);
+  display.setCursor(block.lineX(2), block.lineY(2));
+  display.printf("Volts: %.2f V", snap.batteryVolts);
+  display.setCursor(block.lineX(3), block.lineY(3));
+  display.printf("Charge: %i%%", snap.batteryPercent);
+}
+
+void Screens::drawPressedButtons(const UiSnapshot &snap)
+{
+  display.setFont(&FreeMonoBold12pt7b);
+  display.setCursor(Layout::BUTTONS.x, Layout::BUTTONS.baseline);
+  bool anyPressed = false;
+  for (int i = 0; i <= 6; i++)
+  {
+    if (snap.pressedMask & (1 << i))
+    {
+      if (!anyPressed)
+      {
+        display.print("Pressing:");
+        anyPressed = true;
+      }
+      display.print(" ");
+      display.print(InputManager::getButtonName(i));
+    }
+  }
+  if (!anyPressed)
+  {
+    display.print("Press any button");
+  }
+}
+
+static_assert(Layout::FILES.lines == 1 + FILE_LINES, "file list layout holds a title and FILE_LINES entries");
+
+void Screens::drawFiles(const UiSnapshot &snap, Arena &arena)
+{
+  const Layout::TextBlock &block = Layout::FILES;
+  constexpr int maxChars = block.maxChars();
+
+  display.setFont(&FreeMonoBold12pt7b);
+  display.setCursor(block.lineX(0), block.lineY(0));
+
+  auto drawTruncated = [&](int lineIdx, const char *text)
+  {
+    // Render a single line, truncating with ellipsis if needed
+    if ((int) strlen(text) > maxChars)
+    {
+      char *s = arena.printf("%.*s…", maxChars - 1, text);
+      if (s) text = s;
+    }
+    display.setCursor(block.lineX(1 + lineIdx), block.lineY(1 + lineIdx));
+    display.print(text);
+  };
+
+  if (!snap.sdReady)
+  {
+    display.print("Files on SD:");
+    drawTruncated(0, "No card");
+    return;
+  }
+
+  if (snap.fileTotal == 0)
+  {
+    display.print("Files on SD:");
+    if (snap.indexing)
+    {
+      display.setCursor(block.lineX(1), block.lineY(1));
+      display.printf("Indexing... %u", (unsigned) snap.indexedEntries);
+    }
+    else
+    {
+      drawTruncated(0, "Empty");
+    }
+    return;
+  }
+
+  display.printf("Files %u-%u of %u%s:", (unsigned) snap.fileTop + 1, (unsigned) (snap.fileTop + snap.fileCount),
+                 (unsigned) snap.fileTotal, snap.indexing ? "*" : "");
+
+  for (int i = 0; i < snap.fileCount; i++)
+  {
+    const FileBrowser::Entry &entry = snap.files[i];
+    const char *name = entry.name;
+    if (entry.flags & FileBrowser::FLAG_DIR)
+    {
+      const char *dirName = arena.printf("%s/", entry.name);
+      if (dirName) name = dirName;
+    }
+    drawTruncated(i, name);
+  }
+}
+
+void Screens::drawInitial(const UiSnapshot &snap, Arena &arena)
+{
+  // Header font
+  display.setFont(&FreeMonoBold18pt7b);
+  display.setCursor(Layout::HEADER.x, Layout::HEADER.baseline);
+  display.print("Xteink X4 Sample");
+
+  // Button text with smaller font
+  drawPressedButtons(snap);
+
+  // Draw battery information
+  drawBattery(snap);
+  // Draw the SD file window below the battery block
+  drawFiles(snap, arena);
+
+  // Draw image at bottom right
+  const Layout::Rect &img = Layout::IMAGE;
+  display.drawBitmap(img.x, img.y, dr_mario, img.w, img.h, GxEPD_BLACK);
+}
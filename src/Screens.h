@@ -0,0 +1,27 @@
+#ifndef _SCREENS_H_
+#define _SCREENS_H_
+
+#include <Arduino.h>
+
+#include "Arena.h"
+#include "UiSnapshot.h"
+
+// Main screen content, drawn from a snapshot into the display frame buffer.
+//
+// Used by the render task and by the benchmark, on the device and in the
+// native_bench host build. Per-frame strings come from arena, which the
+// caller rewinds after every frame.
+class Screens
+{
+public:
+  // Welcome screen (DISPLAY_INITIAL): header, buttons, battery, file list
+  // and the dr_mario bitmap
+  static void drawInitial(const UiSnapshot &snap, Arena &arena);
+  // The buttons held when the snapshot was taken
+  static void drawPressedButtons(const UiSnapshot &snap);
+  static void drawBattery(const UiSnapshot &snap);
+  // Current window of the SD root listing, below the battery block
+  static void drawFiles(const UiSnapshot &snap, Arena &arena);
+};
+
+#endif
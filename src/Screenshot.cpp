@@ -0,0 +1,93 @@
+#include "Screenshot.h"
+
+#include "Display.h"
+#include "Hal.h"
+#include "Layout.h"
+
+static const uint32_t ROW_BYTES = DisplayPanel::WIDTH / 8;
+static const uint32_t BAND_BYTES = ROW_BYTES * Screenshot::BAND_ROWS;
+
+// Worst case PackBits output: one control byte per 128 literals
+static uint8_t g_packed[BAND_BYTES + BAND_BYTES / 128 + 1];
+
+static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// PackBits: control byte n < 128 copies n + 1 literals, n >= 128 repeats the
+// next byte 257 - n times; runs shorter than 3 stay literal
+static size_t packBits(const uint8_t *data, size_t len, uint8_t *out)
+{
+  size_t o = 0;
+  size_t i = 0;
+  while (i < len)
+  {
+    size_t run = 1;
+    while (i + run < len && run < 128 && data[i + run] == data[i])
+    {
+      run++;
+    }
+    if (run >= 3)
+    {
+      out[o++] = 257 - run;
+      out[o++] = data[i];
+      i += run;
+      continue;
+    }
+
+    size_t start = i;
+    while (i < len && i - start < 128)
+    {
+      if (i + 2 < len && data[i] == data[i + 1] && data[i] == data[i + 2])
+      {
+        break;
+      }
+      i++;
+    }
+    out[o++] = i - start - 1;
+    memcpy(out + o, data + start, i - start);
+    o += i - start;
+  }
+  return o;
+}
+
+static void printBase64(Print &out, const uint8_t *data, size_t len)
+{
+  char quad[4];
+  for (size_t i = 0; i < len; i += 3)
+  {
+    uint32_t v = data[i] << 16;
+    if (i + 1 < len) v |= data[i + 1] << 8;
+    if (i + 2 < len) v |= data[i + 2];
+    quad[0] = BASE64[(v >> 18) & 63];
+    quad[1] = BASE64[(v >> 12) & 63];
+    quad[2] = i + 1 < len ? BASE64[(v >> 6) & 63] : '=';
+    quad[3] = i + 2 < len ? BASE64[v & 63] : '=';
+    out.write((const uint8_t *) quad, sizeof(quad));
+  }
+  out.println();
+}
+
+void Screenshot::dump(Print &out)
+{
+  const uint8_t *frame = display.epd2.shadow();
+  uint32_t startSeq = display.epd2.frameSeq();
+  uint32_t startWrites = display.epd2.writeSeq();
+  unsigned long start = Hal::millis();
+  uint32_t packedTotal = 0;
+
+  out.printf("SCREENSHOT BEGIN width=%u height=%u rotation=%u seq=%u writes=%u\n", (unsigned) DisplayPanel::WIDTH,
+             (unsigned) DisplayPanel::HEIGHT, (unsigned) Layout::ROTATION, (unsigned) startSeq, (unsigned) startWrites);
+
+  for (uint32_t offset = 0; offset < X4Panel::SHADOW_SIZE; offset += BAND_BYTES)
+  {
+    uint32_t len = X4Panel::SHADOW_SIZE - offset < BAND_BYTES ? X4Panel::SHADOW_SIZE - offset : BAND_BYTES;
+    size_t packed = packBits(frame + offset, len, g_packed);
+    packedTotal += packed;
+    printBase64(out, g_packed, packed);
+    // Let the render task run between bands
+    vTaskDelay(1);
+  }
+
+  out.printf("SCREENSHOT END raw=%u packed=%u ms=%lu seq=%u writes=%u\n", (unsigned) X4Panel::SHADOW_SIZE,
+             (unsigned) packedTotal, Hal::millis() - start, (unsigned) display.epd2.frameSeq(),
+             (unsigned) display.epd2.writeSeq());
+}
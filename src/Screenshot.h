@@ -0,0 +1,27 @@
+#ifndef _SCREENSHOT_H_
+#define _SCREENSHOT_H_
+
+#include <Arduino.h>
+
+// Dump of the panel RAM shadow over the serial console.
+//
+// The frame is PackBits compressed (the .x4i codec) in bands of BAND_ROWS
+// native rows and streamed as base64 lines between text markers:
+//
+//   SCREENSHOT BEGIN width=800 height=480 rotation=3 seq=<n> writes=<n>
+//   <one base64 line per band>
+//   SCREENSHOT END raw=<bytes> packed=<bytes> ms=<n> seq=<n> writes=<n>
+//
+// The task yields between bands, so a dump never holds up rendering; a
+// frame refreshed (seq) or written, such as image chunks streamed before
+// their refresh (writes), meanwhile shows up as differing values and the
+// host script asks for a retry. tools/screenshot.py turns the text into a PNG.
+class Screenshot
+{
+public:
+  static constexpr int BAND_ROWS = 16;
+
+  static void dump(Print &out);
+};
+
+#endif
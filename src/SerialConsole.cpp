@@ -0,0 +1,66 @@
+#include "SerialConsole.h"
+
+static ConsoleCommand g_commands[SerialConsole::MAX_COMMANDS];
+static int g_commandCount = 0;
+static char g_line[SerialConsole::MAX_LINE];
+static int g_lineLen = 0;
+
+bool SerialConsole::add(const ConsoleCommand &command)
+{
+  if (g_commandCount >= MAX_COMMANDS)
+  {
+    return false;
+  }
+  g_commands[g_commandCount++] = command;
+  return true;
+}
+
+void SerialConsole::poll()
+{
+  while (Serial.available() > 0)
+  {
+    int c = Serial.read();
+    if (c == '\r' || c == '\n')
+    {
+      if (g_lineLen > 0)
+      {
+        g_line[g_lineLen] = '\0';
+        g_lineLen = 0;
+        dispatch(g_line);
+      }
+    }
+    else if (g_lineLen < MAX_LINE - 1)
+    {
+      g_line[g_lineLen++] = (char) c;
+    }
+  }
+}
+
+void SerialConsole::dispatch(char *line)
+{
+  char *args = strchr(line, ' ');
+  if (args)
+  {
+    *args++ = '\0';
+    while (*args == ' ') args++;
+  }
+  else
+  {
+    args = line + strlen(line);
+  }
+
+  for (int i = 0; i < g_commandCount; i++)
+  {
+    if (strcmp(line, g_commands[i].name) == 0)
+    {
+      g_commands[i].handler(args);
+      return;
+    }
+  }
+
+  Serial.println("Commands:");
+  for (int i = 0; i < g_commandCount; i++)
+  {
+    Serial.printf("  %-10s %s\n", g_commands[i].name, g_commands[i].help);
+  }
+}
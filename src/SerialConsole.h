@@ -0,0 +1,32 @@
+#ifndef _SERIAL_CONSOLE_H_
+#define _SERIAL_CONSOLE_H_
+
+#include <Arduino.h>
+
+// Minimal line-based command console on the USB-CDC serial port.
+//
+// Commands are static tables registered at startup; poll() is non-blocking
+// and dispatches "<name> [args]" lines to the matching handler.
+struct ConsoleCommand
+{
+  const char *name;
+  const char *help;
+  void (*handler)(const char *args);
+};
+
+class SerialConsole
+{
+public:
+  static constexpr int MAX_COMMANDS = 16;
+  static constexpr int MAX_LINE = 96;
+
+  // Register a command, returns false when the table is full
+  static bool add(const ConsoleCommand &command);
+  // Read pending serial input and run completed lines
+  static void poll();
+
+private:
+  static void dispatch(char *line);
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "Settings.h"
+
+#include <Preferences.h>
+
+#include "X4Panel.h"
+
+#define SETTINGS_NAMESPACE "settings"
+
+#define DEFAULT_SPI_HZ 40000000
+
+#ifdef DEBUG_IO
+#define DEFAULT_DEBUG_IO 1
+#else
+#define DEFAULT_DEBUG_IO 0
+#endif
+
+// One entry per SettingsValues field; the field size is its NVS type and
+// keys are NVS keys (at most 15 characters)
+struct SettingDef
+{
+  const char *key;
+  uint16_t offset;
+  uint8_t size;
+  uint32_t min;
+  uint32_t max;
+  uint32_t def;
+  const char *help;
+};
+
+#define SETTING(key, field, min, max, def, help) \
+  {key, offsetof(SettingsValues, field), sizeof(SettingsValues::field), min, max, def, help}
+
+static const SettingDef SETTINGS[] = {
+  SETTING("spi_hz", spiHz, 1000000, 80000000, DEFAULT_SPI_HZ, "panel bus clock; SD after a reboot"),
+  SETTING("wake_ms", powerWakeupMs, 0, 10000, 1000, "power hold to boot from sleep"),
+  SETTING("sleep_ms", powerSleepMs, 0, 10000, 1000, "power hold to enter sleep"),
+  SETTING("io_poll_ms", ioPollMs, 10, 1000, 50, "input and SD poll period"),
+  SETTING("refresh_mode", refreshMode, 0, REFRESH_MODE_COUNT - 1, REFRESH_FULL, "0 full, 1 fast, 2 partial, 3 a2"),
+  SETTING("auto_refresh", autoRefresh, 0, 1, 1, "diff full-window updates"),
+  SETTING("full_tiles", autoFullTiles, 0, FrameDiff::TILES, X4Panel::AUTO_FULL_TILES,
+          "changed tiles above which auto refresh goes full"),
+  SETTING("max_partials", autoMaxPartials, 0, 255, X4Panel::AUTO_MAX_PARTIALS,
+          "partial refreshes before a full one"),
+  SETTING("debug_io", debugIo, 0, 1, DEFAULT_DEBUG_IO, "print buttons and battery on input"),
+  SETTING("idle_ms", idleMs, 0, 86400000, 30000, "inactivity before light sleep between polls, 0 off"),
+  SETTING("hibernate_ms", hibernateMs, 0, 86400000, 120000, "inactivity before panel hibernate, 0 off"),
+  SETTING("auto_sleep_ms", autoSleepMs, 0, 86400000, 900000, "inactivity before deep sleep, 0 off"),
+};
+
+static SettingsValues g_values;
+static Settings::ChangeFn g_onChange = NULL;
+
+static uint32_t readField(const SettingDef &def)
+{
+  const uint8_t *p = (const uint8_t *) &g_values + def.offset;
+  switch (def.size)
+  {
+  case 1:
+    return *p;
+  case 2:
+    return *(const uint16_t *) p;
+  default:
+    return *(const uint32_t *) p;
+  }
+}
+
+static void writeField(const SettingDef &def, uint32_t value)
+{
+  uint8_t *p = (uint8_t *) &g_values + def.offset;
+  switch (def.size)
+  {
+  case 1:
+    *p = value;
+    break;
+  case 2:
+    *(uint16_t *) p = value;
+    break;
+  default:
+    *(uint32_t *) p = value;
+    break;
+  }
+}
+
+static const SettingDef *findSetting(const char *key)
+{
+  for (const SettingDef &def : SETTINGS)
+  {
+    if (strcmp(def.key, key) == 0)
+    {
+      return &def;
+    }
+  }
+  return NULL;
+}
+
+static void changed()
+{
+  if (g_onChange)
+  {
+    g_onChange();
+  }
+}
+
+void Settings::begin()
+{
+  Preferences prefs;
+  bool opened = prefs.begin(SETTINGS_NAMESPACE, true);
+  for (const SettingDef &def : SETTINGS)
+  {
+    uint32_t value = opened ? prefs.getUInt(def.key, def.def) : def.def;
+    // Values saved by a build with other limits fall back to the default
+    writeField(def, value >= def.min && value <= def.max ? value : def.def);
+  }
+  if (opened)
+  {
+    prefs.end();
+  }
+}
+
+const SettingsValues &Settings::values()
+{
+  return g_values;
+}
+
+bool Settings::set(const char *key, uint32_t value)
+{
+  const SettingDef *def = findSetting(key);
+  if (!def || value < def->min || value > def->max)
+  {
+    return false;
+  }
+  writeField(*def, value);
+  changed();
+  return true;
+}
+
+bool Settings::set(const char *key, const char *value)
+{
+  char *end;
+  unsigned long parsed = strtoul(value, &end, 0);
+  if (*value == '\0' || *end != '\0')
+  {
+    return false;
+  }
+  return set(key, (uint32_t) parsed);
+}
+
+void Settings::reset()
+{
+  for (const SettingDef &def : SETTINGS)
+  {
+    writeField(def, def.def);
+  }
+  changed();
+}
+
+bool Settings::save()
+{
+  Preferences prefs;
+  if (!prefs.begin(SETTINGS_NAMESPACE, false))
+  {
+    return false;
+  }
+  bool ok = true;
+  for (const SettingDef &def : SETTINGS)
+  {
+    // NVS skips rewriting unchanged values, so saving wears nothing
+    ok = prefs.putUInt(def.key, readField(def)) > 0 && ok;
+  }
+  prefs.end();
+  return ok;
+}
+
+void Settings::onChange(ChangeFn fn)
+{
+  g_onChange = fn;
+}
+
+void Settings::print(Print &out)
+{
+  for (const SettingDef &def : SETTINGS)
+  {
+    uint32_t value = readField(def);
+    out.printf("  %-12s %10u%s [%u..%u] %s\n", def.key, (unsigned) value, value == def.def ? " " : "*",
+               (unsigned) def.min, (unsigned) def.max, def.help);
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef _SETTINGS_H_
+#define _SETTINGS_H_
+
+#include <Arduino.h>
+
+// Tunables kept in the "nvs" partition, so bus speed, refresh policy and
+// timings can be adjusted per unit without a rebuild.
+//
+// The values are cached in one struct that tasks read directly. The serial
+// "config" command changes them at runtime and the change callback applies
+// them to the running firmware; they only reach flash on save(), so a reset
+// undoes an experiment. Pins are not settings: the panel and SD objects are
+// constructed before anything is loaded, and the board wiring is fixed.
+struct SettingsValues
+{
+  uint32_t spiHz;          // Panel and SD bus clock
+  uint16_t powerWakeupMs;  // Power hold needed to boot from deep sleep
+  uint16_t powerSleepMs;   // Power hold needed to go to sleep
+  uint16_t ioPollMs;       // I/O task poll period
+  uint8_t refreshMode;     // RefreshMode
+  uint8_t autoRefresh;     // Diff-driven full-window updates
+  uint8_t autoFullTiles;   // Changed tiles above which auto refresh goes full
+  uint8_t autoMaxPartials; // Partial refreshes in a row before a full one
+  uint8_t debugIo;         // Print button and battery state on every input edge
+  uint32_t idleMs;         // Inactivity before light-sleeping between polls
+  uint32_t hibernateMs;    // Inactivity before hibernating the panel
+  uint32_t autoSleepMs;    // Inactivity before deep sleep
+};
+
+class Settings
+{
+public:
+  typedef void (*ChangeFn)();
+
+  // Load from NVS, missing keys take their defaults
+  static void begin();
+  static const SettingsValues &values();
+
+  // Range-checked update of one value by key, applied through the change
+  // callback but not saved. False for an unknown key or a bad value.
+  static bool set(const char *key, uint32_t value);
+  static bool set(const char *key, const char *value);
+  // Restore the defaults (not saved)
+  static void reset();
+  static bool save();
+
+  // Called after every change, to apply the values
+  static void onChange(ChangeFn fn);
+
+  static void print(Print &out);
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _SPSC_RING_H_
+#define _SPSC_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Bounded single-producer single-consumer ring of value types.
+//
+// Only plain aligned 32-bit loads and stores are used on the indices, so it
+// is lock-free even on the ESP32-C3, which has no atomic read-modify-write
+// instructions. Exactly one task may push and exactly one task may pop.
+template <typename T, size_t N>
+class SpscRing
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+  // Producer side, returns false when the ring is full
+  bool push(const T &item)
+  {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) >= N)
+    {
+      return false;
+    }
+    _items[head & (N - 1)] = item;
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, returns false when the ring is empty
+  bool pop(T &item)
+  {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    item = _items[tail & (N - 1)];
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side: the item the next pop() would return, or nullptr
+  const T *peek() const
+  {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire))
+    {
+      return nullptr;
+    }
+    return &_items[tail & (N - 1)];
+  }
+
+  size_t size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+
+private:
+  T _items[N];
+  std::atomic<uint32_t> _head{0};
+  std::atomic<uint32_t> _tail{0};
+};
+
+#endif
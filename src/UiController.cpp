@@ -0,0 +1,320 @@
+#include "UiController.h"
+
+#include "EventLog.h"
+#include "Hal.h"
+
+void UiController::begin()
+{
+  _gestures.setRepeat(InputManager::BTN_LEFT, true);
+  _gestures.setRepeat(InputManager::BTN_RIGHT, true);
+  _gestures.setMultiTap(InputManager::BTN_BACK, true);
+  _gestures.addChord(GestureEngine::mask(InputManager::BTN_UP) | GestureEngine::mask(InputManager::BTN_DOWN));
+}
+
+DisplayCommand UiController::merge(DisplayCommand pending, DisplayCommand next)
+{
+  if (pending == DISPLAY_NONE || pending == next)
+  {
+    return next;
+  }
+  if (pending == DISPLAY_SLEEP || next == DISPLAY_SLEEP)
+  {
+    return DISPLAY_SLEEP;
+  }
+  if (next == DISPLAY_INITIAL || next == DISPLAY_IMAGE || isBenchmark(next))
+  {
+    return next;
+  }
+  if (pending == DISPLAY_IMAGE || isBenchmark(pending))
+  {
+    return pending;
+  }
+  return DISPLAY_INITIAL;
+}
+
+void UiController::request(DisplayCommand cmd)
+{
+  uint8_t pending = _requested.load();
+  while (!_requested.compare_exchange_weak(pending, merge((DisplayCommand) pending, cmd)))
+  {
+  }
+}
+
+bool UiController::publish()
+{
+  bool force = _forcePublish;
+  _forcePublish = false;
+  return publish(force);
+}
+
+bool UiController::publish(bool force)
+{
+  if (!force && _sink.renderBusy())
+  {
+    return false;
+  }
+
+  DisplayCommand cmd = (DisplayCommand) _requested.exchange(DISPLAY_NONE);
+  if (cmd == DISPLAY_NONE)
+  {
+    return false;
+  }
+  if (!_sink.publish(cmd))
+  {
+    // Render is behind: retry on the next poll, merged with newer requests
+    request(cmd);
+  }
+  return true;
+}
+
+// Page through the SD listing, wrapping at both ends
+void UiController::scrollFiles(int delta)
+{
+  uint32_t total = _sink.fileCount();
+  if (total == 0)
+  {
+    return;
+  }
+  int64_t top = (int64_t) _state.fileTop + delta;
+  if (top < 0)
+  {
+    top = (total - 1) / FILE_LINES * FILE_LINES;
+  }
+  else if (top >= total)
+  {
+    top = 0;
+  }
+  _state.fileTop = top;
+  request(DISPLAY_FILES);
+}
+
+// Image viewer navigation: Left/Right browse (hold to skip faster), Up
+// toggles stream/buffered decoding for time-to-image comparison, Back
+// returns to the main screen
+void UiController::viewerGesture(const Gesture &g)
+{
+  if (g.type == GESTURE_PRESS || g.type == GESTURE_REPEAT)
+  {
+    int step = g.type == GESTURE_REPEAT ? g.step : 1;
+    if (g.button == InputManager::BTN_LEFT || g.button == InputManager::BTN_RIGHT)
+    {
+      // Repeats add up here and are applied by the next snapshot
+      _state.viewerStep = _state.viewerStep + (g.button == InputManager::BTN_RIGHT ? step : -step);
+      request(DISPLAY_IMAGE);
+    }
+  }
+  if (g.type == GESTURE_TAP && g.button == InputManager::BTN_UP)
+  {
+    // On tap, not press: Up is also half of the Up + Down chord, whose
+    // buttons report no tap
+    _state.viewerMode =
+      _state.viewerMode == ImageViewer::MODE_STREAM ? ImageViewer::MODE_BUFFERED : ImageViewer::MODE_STREAM;
+    request(DISPLAY_IMAGE);
+  }
+  if (g.type != GESTURE_PRESS)
+  {
+    return;
+  }
+
+  if (g.button == InputManager::BTN_BACK)
+  {
+    _state.viewerActive = false;
+    request(DISPLAY_INITIAL);
+  }
+}
+
+// Main screen: Left/Right page the file list (hold to scroll, accelerating),
+// Confirm opens the image viewer, a long Confirm re-indexes the card, a
+// double Back jumps to the first page. Other edges redraw the pressed
+// buttons.
+void UiController::mainGesture(const Gesture &g)
+{
+  bool nav = g.button == InputManager::BTN_LEFT || g.button == InputManager::BTN_RIGHT;
+  int dir = g.button == InputManager::BTN_RIGHT ? 1 : -1;
+
+  switch (g.type)
+  {
+  case GESTURE_PRESS:
+    if (nav)
+    {
+      scrollFiles(dir * FILE_LINES);
+    }
+    else
+    {
+      request(DISPLAY_TEXT);
+    }
+    break;
+  case GESTURE_REPEAT:
+    if (nav)
+    {
+      scrollFiles(dir * FILE_LINES * g.step);
+    }
+    break;
+  case GESTURE_RELEASE:
+    // After a scroll burst the list is already up to date
+    if (g.count == 0)
+    {
+      request(DISPLAY_TEXT);
+    }
+    break;
+  case GESTURE_TAP:
+    if (g.button == InputManager::BTN_CONFIRM)
+    {
+      _state.viewerActive = true;
+      _state.viewerRescan = true;
+      request(DISPLAY_IMAGE);
+    }
+    else if (g.button == InputManager::BTN_BACK && g.count == 2 && _state.fileTop != 0)
+    {
+      _state.fileTop = 0;
+      request(DISPLAY_FILES);
+    }
+    break;
+  case GESTURE_LONG_PRESS:
+    if (g.button == InputManager::BTN_CONFIRM)
+    {
+      _sink.rebuildIndex();
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void UiController::handleGesture(const Gesture &g, uint32_t now)
+{
+  if (g.type == GESTURE_CHORD)
+  {
+    // Up + Down: full refresh to clear partial refresh ghosting
+    _sink.requestFullRefresh();
+    request(_state.viewerActive ? DISPLAY_IMAGE : DISPLAY_INITIAL);
+    return;
+  }
+
+  if (g.type == GESTURE_RELEASE && g.button == InputManager::BTN_POWER && g.heldMs > _sleepHoldMs)
+  {
+    // Power button long pressed => go to sleep
+    Serial.printf("Power button released after %lums. Entering deep sleep.\n", (unsigned long) g.heldMs);
+    enterDeepSleep(now);
+    return;
+  }
+
+  if (_state.viewerActive)
+  {
+    viewerGesture(g);
+  }
+  else
+  {
+    mainGesture(g);
+  }
+}
+
+// Held buttons keep updating state every poll, publish() coalesces the
+// resulting requests into one refresh at a time
+void UiController::poll(const InputManager &input, bool usb, uint32_t pollMs)
+{
+  handleInput(input, Hal::millis());
+
+  if (!publish())
+  {
+    // Index and log work only runs on polls without a display request
+    _sink.backgroundWork();
+  }
+
+  updatePower(Hal::millis(), usb);
+  if (_power.stage() >= POWER_IDLE)
+  {
+    // One tick for the lower priority tasks, then sleep the whole chip
+    // unless the render task has work
+    Hal::delay(1);
+    if (canLightSleep())
+    {
+      // No longer than the active poll, so the ADC ladder buttons, which
+      // cannot wake the chip, are sampled as often as when active
+      Hal::lightSleep(pollMs); // Woken early by the power button
+    }
+  }
+  else
+  {
+    Hal::delay(pollMs);
+  }
+}
+
+void UiController::handleInput(const InputManager &input, uint32_t now)
+{
+  uint8_t pressed = 0;
+  uint8_t released = 0;
+  for (int b = 0; b < GestureEngine::BUTTONS; b++)
+  {
+    if (input.wasPressed(b)) pressed |= GestureEngine::mask(b);
+    if (input.wasReleased(b)) released |= GestureEngine::mask(b);
+  }
+  _gestures.update(pressed, released, now);
+  if (pressed || released)
+  {
+    _power.activity(now);
+  }
+
+  Gesture g;
+  while (_gestures.next(g))
+  {
+    handleGesture(g, now);
+  }
+}
+
+void UiController::updatePower(uint32_t now, bool usb)
+{
+  // USB power costs no battery, and light sleep would drop the USB serial
+  // link
+  if (usb)
+  {
+    _power.activity(now);
+  }
+
+  PowerStage stage = _power.target(now);
+  // Deep sleep is only left through the wake reset
+  if (stage == _power.stage() || _power.stage() == POWER_DEEP_SLEEP)
+  {
+    return;
+  }
+  if (stage == POWER_DEEP_SLEEP)
+  {
+    Serial.println("Inactive, entering deep sleep.");
+    enterDeepSleep(now); // Records the stage
+    return;
+  }
+  _power.enter(stage, now, _sink.batteryMv());
+  if (stage == POWER_HIBERNATE)
+  {
+    _sink.hibernate();
+  }
+}
+
+bool UiController::canLightSleep()
+{
+  return _power.stage() >= POWER_IDLE && !_sink.renderBusy() && pending() == DISPLAY_NONE;
+}
+
+void UiController::enterDeepSleep(uint32_t now)
+{
+  _power.enter(POWER_DEEP_SLEEP, now, _sink.batteryMv());
+  EventLog::log(EVT_SLEEP, now);
+  request(DISPLAY_SLEEP);
+
+  // Called from the I/O task, which would publish it next: hand the sleep
+  // screen over as soon as the ring has room, then wait until it is drawn
+  uint32_t start = Hal::millis();
+  while (Hal::millis() - start < SLEEP_SCREEN_TIMEOUT_MS)
+  {
+    if (pending() != DISPLAY_NONE)
+    {
+      publish(true);
+    }
+    else if (!_sink.renderBusy())
+    {
+      break;
+    }
+    Hal::delay(SLEEP_SCREEN_POLL_MS);
+  }
+  _sink.deepSleep();
+}
@@ -0,0 +1,124 @@
+#ifndef _UI_CONTROLLER_H_
+#define _UI_CONTROLLER_H_
+
+#include <Arduino.h>
+#include <InputManager.h>
+#include <atomic>
+
+#include "GestureEngine.h"
+#include "PowerManager.h"
+#include "UiSnapshot.h"
+
+// What the UI logic drives. The firmware implements it over the render
+// task, the panel and the SD index; the host tests record the calls.
+class UiSink
+{
+public:
+  // Capture a snapshot for cmd and queue it for the render task, false when
+  // the queue is full
+  virtual bool publish(DisplayCommand cmd) = 0;
+  // A render or a panel hibernation is running or queued
+  virtual bool renderBusy() = 0;
+  // Make the next full-window refresh use the full waveform
+  virtual void requestFullRefresh() = 0;
+  // Put the panel controller in deep sleep, the next refresh wakes it
+  virtual void hibernate() = 0;
+  // Power down; does not return on the device
+  virtual void deepSleep() = 0;
+  virtual void rebuildIndex() = 0;
+  // One bounded unit of index or log work, on polls without a publish
+  virtual void backgroundWork() = 0;
+  // Entries in the SD listing
+  virtual uint32_t fileCount() = 0;
+  virtual uint16_t batteryMv() = 0;
+
+protected:
+  ~UiSink() = default;
+};
+
+// Screen state changed by input, read when a snapshot is captured
+struct UiState
+{
+  uint32_t fileTop;
+  volatile bool viewerActive;
+  volatile bool viewerRescan;
+  volatile int viewerStep; // Pending Left/Right steps, applied by the snapshot
+  volatile ImageViewer::Mode viewerMode;
+};
+
+// Input, display request and power logic of the I/O task.
+//
+// Kept apart from the tasks, the panel and the card so the host build can
+// drive it with a scripted clock and fake buttons (test/test_timeline). The
+// I/O task samples the buttons and calls poll(), which runs handleInput(),
+// turning button edges into gestures and gestures into display requests,
+// then publish(), handing the merged request to the sink once the render
+// task is free, then updatePower() to follow the inactivity stages, and
+// waits for the next poll. Requests from other tasks (serial console,
+// recovery) go through request(), which is lock-free.
+class UiController
+{
+public:
+  // Longest wait for the sleep screen before deep sleep, kept under the I/O
+  // task heartbeat
+  static constexpr uint32_t SLEEP_SCREEN_TIMEOUT_MS = 4000;
+  static constexpr uint32_t SLEEP_SCREEN_POLL_MS = 20;
+
+  explicit UiController(UiSink &sink) : _sink(sink) {}
+
+  // Gestures of the X4 buttons
+  void begin();
+
+  // Power button hold that sends the device to sleep on release
+  void setSleepHoldMs(uint32_t ms) { _sleepHoldMs = ms; }
+  PowerManager &power() { return _power; }
+  UiState &state() { return _state; }
+
+  // Merge a new display request into a pending one: the same screen stays,
+  // different regions of the main screen collapse into one full redraw
+  static DisplayCommand merge(DisplayCommand pending, DisplayCommand next);
+  static bool isBenchmark(DisplayCommand cmd)
+  {
+    return cmd == DISPLAY_BENCHMARK || cmd == DISPLAY_BENCHMARK_REFRESH;
+  }
+  // Ask for a refresh, safe from any task
+  void request(DisplayCommand cmd);
+  DisplayCommand pending() const { return (DisplayCommand) _requested.load(); }
+  // Publish on the next poll even with snapshots queued, safe from any task
+  void forcePublish() { _forcePublish = true; }
+
+  // One pass of the I/O task on freshly sampled input: gestures, publish or
+  // background work, power stages, then wait or light-sleep for pollMs
+  void poll(const InputManager &input, bool usb, uint32_t pollMs);
+
+  void handleInput(const InputManager &input, uint32_t now);
+  // Hand the pending request to the sink, returns true when one was handed
+  // over. While a render is running or queued requests keep merging, so a
+  // burst of input costs one refresh captured as late as possible.
+  bool publish();
+  // Follow the inactivity stages, USB power counts as activity
+  void updatePower(uint32_t now, bool usb);
+  // Idle with nothing to render: the I/O task may light-sleep until its
+  // next poll
+  bool canLightSleep();
+  // Show the sleep screen and power down once it is drawn, or after
+  // SLEEP_SCREEN_TIMEOUT_MS
+  void enterDeepSleep(uint32_t now);
+
+private:
+  bool publish(bool force);
+  void handleGesture(const Gesture &g, uint32_t now);
+  void mainGesture(const Gesture &g);
+  void viewerGesture(const Gesture &g);
+  void scrollFiles(int delta);
+
+  UiSink &_sink;
+  GestureEngine _gestures;
+  PowerManager _power;
+  UiState _state = {0, false, false, 0, ImageViewer::MODE_STREAM};
+  std::atomic<uint8_t> _requested{DISPLAY_NONE};
+  volatile bool _forcePublish = false;
+  uint32_t _sleepHoldMs = 0;
+};
+
+#endif
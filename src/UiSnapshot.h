@@ -0,0 +1,59 @@
+#ifndef _UI_SNAPSHOT_H_
+#define _UI_SNAPSHOT_H_
+
+#include <Arduino.h>
+
+#include "FileBrowser.h"
+#include "ImageViewer.h"
+
+// Display command enum
+enum DisplayCommand : uint8_t
+{
+  DISPLAY_NONE = 0,
+  DISPLAY_INITIAL,
+  DISPLAY_TEXT,
+  DISPLAY_BATTERY,
+  DISPLAY_FILES,
+  DISPLAY_IMAGE,
+  DISPLAY_BENCHMARK,
+  DISPLAY_SLEEP,
+  DISPLAY_BENCHMARK_REFRESH
+};
+
+// Number of SD entries shown per page
+#define FILE_LINES 5
+
+// Everything the render task needs for one refresh, captured by the I/O
+// task. Snapshots are immutable once pushed: rendering never touches the
+// SD card index, the ADC or the input manager.
+struct UiSnapshot
+{
+  DisplayCommand command;
+  uint32_t createdMs;
+
+  // Input
+  uint8_t pressedMask; // Bit i set while button i is held
+
+  // Battery
+  bool charging;
+  uint16_t batteryRawMv;
+  float batteryVolts;
+  uint16_t batteryPercent;
+
+  // SD listing window
+  bool sdReady;
+  bool indexing;
+  uint32_t indexedEntries;
+  uint32_t fileTotal;
+  uint32_t fileTop;
+  uint8_t fileCount;
+  FileBrowser::Entry files[FILE_LINES];
+
+  // Image viewer
+  bool viewerActive;
+  ImageViewer::Mode viewerMode;
+  int16_t viewerIndex;
+  int16_t imageCount;
+};
+
+#endif
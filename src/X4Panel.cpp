@@ -0,0 +1,378 @@
+#include "X4Panel.h"
+
+#include "Hal.h"
+#include "Metrics.h"
+
+#ifdef METRICS
+// Called by GxEPD2 on every poll while BUSY is asserted
+static void busyCallback(const void *)
+{
+  static unsigned long lastPoll = 0;
+  unsigned long now = Hal::micros();
+  // Polls more than 20ms apart belong to different waits
+  if (now - lastPoll < 20000)
+  {
+    Metrics::addBusyMicros(now - lastPoll);
+  }
+  lastPoll = now;
+  Hal::delay(1);
+}
+#endif
+
+// Forced temperature register values (degrees C) for the short waveforms.
+// The controller picks its OTP waveform by temperature, a hotter value
+// selects shorter phases. Tuned on the bench, warmer rooms tolerate more.
+struct TemperatureBand
+{
+  int8_t minC;     // Lowest measured temperature of the band
+  uint8_t fastReg; // FAST: full waveform temperature
+  uint8_t a2Reg;   // A2: mode 2 waveform temperature
+};
+
+static const TemperatureBand TEMPERATURE_BANDS[] = {
+  {18, 0x5A, 0x6E},
+  {8, 0x50, 0x5A},
+};
+
+// The C3 die sensor reads above ambient, the panel has no readable sensor
+// on this board (its SPI data line is write-only here)
+#define DIE_TEMPERATURE_OFFSET_C 8
+#define TEMPERATURE_PERIOD_MS 60000
+
+#define FAST_REFRESH_TIME 1000
+#define A2_REFRESH_TIME 400
+
+static_assert(FrameDiff::FRAME_W == X4Panel::WIDTH && FrameDiff::FRAME_H == X4Panel::HEIGHT,
+              "frame diff geometry must match the panel");
+
+// Word aligned for FrameDiff
+alignas(4) static uint8_t g_shadow[X4Panel::SHADOW_SIZE];
+
+static const char *const REFRESH_MODE_NAMES[REFRESH_MODE_COUNT] = {"full", "fast", "partial", "a2"};
+static const char *const REFRESH_PLAN_NAMES[] = {"full", "skip", "window"};
+
+static const TemperatureBand *findBand(float temperature)
+{
+  for (const TemperatureBand &band : TEMPERATURE_BANDS)
+  {
+    if (temperature >= band.minC)
+    {
+      return &band;
+    }
+  }
+  return nullptr; // Too cold for the short waveforms
+}
+
+const char *X4Panel::refreshModeName(RefreshMode mode)
+{
+  return mode < REFRESH_MODE_COUNT ? REFRESH_MODE_NAMES[mode] : "?";
+}
+
+const char *X4Panel::refreshPlanName(RefreshPlan plan)
+{
+  return plan <= PLAN_WINDOW ? REFRESH_PLAN_NAMES[plan] : "?";
+}
+
+float X4Panel::temperature()
+{
+  if (_temperatureMs == 0 || Hal::millis() - _temperatureMs > TEMPERATURE_PERIOD_MS)
+  {
+    _temperature = temperatureRead() - DIE_TEMPERATURE_OFFSET_C;
+    _temperatureMs = Hal::millis() | 1;
+  }
+  return _temperature;
+}
+
+uint32_t X4Panel::refreshCostMs(RefreshMode mode) const
+{
+  if (_stats[mode].count)
+  {
+    return _stats[mode].totalMs / _stats[mode].count;
+  }
+  static const uint16_t ESTIMATES[REFRESH_MODE_COUNT] = {full_refresh_time, FAST_REFRESH_TIME, partial_refresh_time,
+                                                         A2_REFRESH_TIME};
+  return ESTIMATES[mode];
+}
+
+// Mode for the next refresh; band is the temperature band for FAST and A2,
+// looked up once so the refresh uses the reading the mode was chosen with
+RefreshMode X4Panel::resolveMode(bool window, const TemperatureBand *&band)
+{
+  RefreshMode mode = _mode;
+  band = nullptr;
+  if (_initial_refresh)
+  {
+    // The first refresh after power up must be a full one
+    return REFRESH_FULL;
+  }
+  if (window && (mode == REFRESH_FULL || mode == REFRESH_FAST))
+  {
+    // Windows never flash
+    mode = REFRESH_PARTIAL;
+  }
+  if (mode == REFRESH_FAST || mode == REFRESH_A2)
+  {
+    band = findBand(temperature());
+    if (!band)
+    {
+      mode = mode == REFRESH_FAST ? REFRESH_FULL : REFRESH_PARTIAL;
+    }
+  }
+  return mode;
+}
+
+void X4Panel::recordRefresh(RefreshMode mode, uint32_t startMs)
+{
+  RefreshStats &stats = _stats[mode];
+  stats.lastMs = Hal::millis() - startMs;
+  stats.totalMs += stats.lastMs;
+  stats.count++;
+
+  if (mode == REFRESH_FULL || mode == REFRESH_FAST)
+  {
+    _partialsSinceFull = 0;
+  }
+  else if (_partialsSinceFull < UINT8_MAX)
+  {
+    _partialsSinceFull++;
+  }
+}
+
+// Pick the update for a whole-screen write from its diff against the panel
+// RAM. The SSD1677 refresh time does not depend on the window size, so
+// several windows cost one partial refresh each while their bounding window
+// costs one: changes are always merged into a single window.
+X4Panel::RefreshPlan X4Panel::planRefresh(const uint8_t bitmap[])
+{
+  FrameDiff::compute(g_shadow, bitmap, _lastDiff);
+  METRICS_RECORD(METRIC_FRAME_DIFF, _lastDiff.micros);
+
+  if (_lastDiff.total == 0)
+  {
+    return PLAN_SKIP;
+  }
+
+  int tiles = __builtin_popcount(_lastDiff.tileMask);
+  const TemperatureBand *band;
+  if (tiles > _autoFullTiles || _partialsSinceFull >= _autoMaxPartials ||
+      refreshCostMs(resolveMode(true, band)) > refreshCostMs(resolveMode(false, band)))
+  {
+    return PLAN_FULL;
+  }
+
+  FrameDiff::bounds(_lastDiff, _planX, _planY, _planW, _planH);
+  return PLAN_WINDOW;
+}
+
+// Full update with the OTP waveform loaded for a forced temperature
+void X4Panel::refreshFast(const TemperatureBand &band)
+{
+  _writeCommand(0x21); // Display update control
+  _writeData(0x40);    // Bypass RED RAM as 0: not differential
+  _writeData(0x00);    // Single chip
+  _writeCommand(0x1A); // Temperature register
+  _writeData(band.fastReg);
+  _writeCommand(0x22); // Clock and analog on, load LUT (no sensor read), mode 1, display, power off
+  _writeData(0xD7);
+  _writeCommand(0x20);
+  _waitWhileBusy("refreshFast", FAST_REFRESH_TIME);
+  _power_is_on = false;
+  _using_partial_mode = false; // The next partial refresh re-initializes
+  _initial_refresh = false;
+}
+
+// Differential mode 2 update of the RAM window set by the preceding image
+// write, with the waveform loaded for a forced temperature
+void X4Panel::refreshA2(const TemperatureBand &band)
+{
+  _writeCommand(0x21); // Display update control
+  _writeData(0x00);    // RED RAM holds the previous image
+  _writeData(0x00);    // Single chip
+  _writeCommand(0x1A); // Temperature register
+  _writeData(band.a2Reg);
+  _writeCommand(0x22); // Clock and analog on, load LUT (no sensor read), mode 2, display
+  _writeData(0xDC);
+  _writeCommand(0x20);
+  _waitWhileBusy("refreshA2", A2_REFRESH_TIME);
+  _power_is_on = true;
+}
+
+void X4Panel::beginInstrumentation()
+{
+#ifdef METRICS
+  setBusyCallback(busyCallback);
+#endif
+}
+
+const uint8_t *X4Panel::shadow() const
+{
+  return g_shadow;
+}
+
+// Same clipping and byte alignment as the GxEPD2 image writes
+void X4Panel::shadowWrite(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h, bool invert,
+                          bool mirror_y)
+{
+  int16_t wb = (w + 7) / 8;
+  x -= x % 8;
+  int16_t x1 = x < 0 ? 0 : x;
+  int16_t y1 = y < 0 ? 0 : y;
+  int16_t w1 = x + w < (int16_t) WIDTH ? w : (int16_t) WIDTH - x;
+  int16_t h1 = y + h < (int16_t) HEIGHT ? h : (int16_t) HEIGHT - y;
+  int16_t dx = x1 - x;
+  int16_t dy = y1 - y;
+  w1 -= dx;
+  h1 -= dy;
+  if (w1 <= 0 || h1 <= 0)
+  {
+    return;
+  }
+  _writeSeq++;
+
+  for (int16_t i = 0; i < h1; i++)
+  {
+    int16_t row = mirror_y ? h - 1 - (i + dy) : i + dy;
+    const uint8_t *src = bitmap + row * wb + dx / 8;
+    uint8_t *dst = g_shadow + (uint32_t) (y1 + i) * (WIDTH / 8) + x1 / 8;
+    if (invert)
+    {
+      for (int16_t j = 0; j < w1 / 8; j++)
+      {
+        dst[j] = ~src[j];
+      }
+    }
+    else
+    {
+      memcpy(dst, src, w1 / 8);
+    }
+  }
+}
+
+void X4Panel::clearScreen(uint8_t value)
+{
+  _plan = PLAN_FULL;
+  memset(g_shadow, value, sizeof(g_shadow));
+  _writeSeq++;
+  GxEPD2_426_GDEQ0426T82::clearScreen(value);
+  _frameSeq++;
+}
+
+void X4Panel::writeScreenBuffer(uint8_t value)
+{
+  _plan = PLAN_FULL;
+  memset(g_shadow, value, sizeof(g_shadow));
+  _writeSeq++;
+  GxEPD2_426_GDEQ0426T82::writeScreenBuffer(value);
+}
+
+void X4Panel::writeImage(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h, bool invert,
+                         bool mirror_y, bool pgm)
+{
+  _plan = PLAN_FULL;
+  METRICS_SPI_BYTES((uint32_t) w * h / 8);
+  shadowWrite(bitmap, x, y, w, h, invert, mirror_y);
+  GxEPD2_426_GDEQ0426T82::writeImage(bitmap, x, y, w, h, invert, mirror_y, pgm);
+}
+
+void X4Panel::writeImageForFullRefresh(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h,
+                                       bool invert, bool mirror_y, bool pgm)
+{
+  _plan = PLAN_FULL;
+  bool wholeScreen = x == 0 && y == 0 && w == WIDTH && h == HEIGHT && !invert && !mirror_y && !pgm;
+  if (_autoRefresh && wholeScreen && !_initial_refresh && !_forceFull)
+  {
+    _plan = planRefresh(bitmap);
+    _lastPlan = _plan;
+  }
+
+  shadowWrite(bitmap, x, y, w, h, invert, mirror_y);
+  if (_plan == PLAN_FULL)
+  {
+    // Written to both the current and the previous image RAM
+    METRICS_SPI_BYTES((uint32_t) w * h / 4);
+    GxEPD2_426_GDEQ0426T82::writeImageForFullRefresh(bitmap, x, y, w, h, invert, mirror_y, pgm);
+  }
+  else if (_plan == PLAN_WINDOW)
+  {
+    // Current RAM only, the previous RAM keeps the old frame for the
+    // differential update
+    METRICS_SPI_BYTES((uint32_t) w * h / 8);
+    GxEPD2_426_GDEQ0426T82::writeImage(bitmap, x, y, w, h, invert, mirror_y, pgm);
+  }
+}
+
+void X4Panel::writeImageAgain(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h, bool invert,
+                              bool mirror_y, bool pgm)
+{
+  METRICS_SPI_BYTES((uint32_t) w * h / 4);
+  shadowWrite(bitmap, x, y, w, h, invert, mirror_y);
+  GxEPD2_426_GDEQ0426T82::writeImageAgain(bitmap, x, y, w, h, invert, mirror_y, pgm);
+}
+
+void X4Panel::refresh(bool partial_update_mode)
+{
+  RefreshPlan plan = _plan;
+  _plan = PLAN_FULL;
+  if (plan == PLAN_SKIP)
+  {
+    return;
+  }
+  if (partial_update_mode)
+  {
+    refresh(0, 0, WIDTH, HEIGHT);
+    return;
+  }
+  if (plan == PLAN_WINDOW)
+  {
+    refresh(_planX, _planY, _planW, _planH);
+    return;
+  }
+
+  METRICS_SCOPE(METRIC_REFRESH);
+  const TemperatureBand *band;
+  RefreshMode mode = resolveMode(false, band);
+  if (_forceFull)
+  {
+    _forceFull = false;
+    mode = REFRESH_FULL;
+  }
+  uint32_t start = Hal::millis();
+  switch (mode)
+  {
+  case REFRESH_FAST:
+    refreshFast(*band);
+    break;
+  case REFRESH_PARTIAL:
+    GxEPD2_426_GDEQ0426T82::refresh(0, 0, WIDTH, HEIGHT);
+    break;
+  case REFRESH_A2:
+    refreshA2(*band);
+    break;
+  default:
+    GxEPD2_426_GDEQ0426T82::refresh(false);
+    break;
+  }
+  recordRefresh(mode, start);
+  _frameSeq++;
+}
+
+void X4Panel::refresh(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  METRICS_SCOPE(METRIC_REFRESH);
+  const TemperatureBand *band;
+  RefreshMode mode = resolveMode(true, band);
+  uint32_t start = Hal::millis();
+  if (mode == REFRESH_A2)
+  {
+    // GxEPD2 writes the window right before refreshing it, so the RAM
+    // window is already set
+    refreshA2(*band);
+  }
+  else
+  {
+    // Also covers the initial refresh, which the base turns into a full one
+    GxEPD2_426_GDEQ0426T82::refresh(x, y, w, h);
+  }
+  recordRefresh(mode, start);
+  _frameSeq++;
+}
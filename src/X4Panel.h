@@ -0,0 +1,147 @@
+#ifndef _X4_PANEL_H_
+#define _X4_PANEL_H_
+
+#include <GxEPD2_BW.h>
+
+#include "FrameDiff.h"
+
+// Refresh waveforms, from best quality to fastest. The mode applies to every
+// refresh issued through the display class:
+//
+//   FULL     OTP full waveform for the controller's measured temperature
+//            (flashes, clears ghosting); windows use PARTIAL
+//   FAST     full waveform loaded for a forced high temperature, the SSD1677
+//            "temperature trick": shorter phases, slight ghosting
+//   PARTIAL  differential mode 2 waveform, no flashing, for whole screens too
+//   A2       mode 2 waveform loaded for a forced high temperature: 1-bit
+//            direct update for page turns and scrolling, ghosts quickly
+//
+// FAST and A2 fall back to FULL and PARTIAL when it is too cold for the
+// short waveforms to fully drive the ink.
+enum RefreshMode : uint8_t
+{
+  REFRESH_FULL = 0,
+  REFRESH_FAST,
+  REFRESH_PARTIAL,
+  REFRESH_A2,
+  REFRESH_MODE_COUNT
+};
+
+struct TemperatureBand;
+
+// GDEQ0426T82 driver with X4 specific hooks.
+//
+// GxEPD2_BW calls the driver through its template type, so the methods
+// declared here hide the base class ones for every buffer write and refresh
+// issued by the display class.
+//
+// Every image write is also copied into a shadow of the panel RAM (native
+// orientation, 1 = white), so the firmware knows what the panel shows even
+// for frames streamed straight to the controller.
+//
+// With auto refresh on, a whole-screen write is first diffed against the
+// shadow and the following full-window refresh becomes the cheapest update
+// that shows the change: none, one partial window or a full refresh.
+class X4Panel : public GxEPD2_426_GDEQ0426T82
+{
+public:
+  struct RefreshStats
+  {
+    uint32_t count;
+    uint32_t lastMs;
+    uint32_t totalMs;
+  };
+
+  // What the next full-window refresh does, decided by the frame diff
+  enum RefreshPlan : uint8_t
+  {
+    PLAN_FULL = 0,
+    PLAN_SKIP,
+    PLAN_WINDOW
+  };
+
+  X4Panel(int16_t cs, int16_t dc, int16_t rst, int16_t busy) : GxEPD2_426_GDEQ0426T82(cs, dc, rst, busy) {}
+
+  static constexpr uint32_t SHADOW_SIZE = (uint32_t) WIDTH / 8 * HEIGHT;
+  // Auto refresh: above this many changed tiles a partial window would cover
+  // most of the screen anyway and leaves more ghosting than a full refresh
+  static constexpr uint8_t AUTO_FULL_TILES = 15;
+  // Partial refreshes in a row before auto refresh goes full to clear ghosting
+  static constexpr uint8_t AUTO_MAX_PARTIALS = 8;
+
+  void clearScreen(uint8_t value = 0xFF);
+  void writeScreenBuffer(uint8_t value = 0xFF);
+  using GxEPD2_426_GDEQ0426T82::writeImage;
+  void writeImage(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h, bool invert = false,
+                  bool mirror_y = false, bool pgm = false);
+  void writeImageForFullRefresh(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h,
+                                bool invert = false, bool mirror_y = false, bool pgm = false);
+  void writeImageAgain(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h, bool invert = false,
+                       bool mirror_y = false, bool pgm = false);
+
+  void refresh(bool partial_update_mode = false);
+  void refresh(int16_t x, int16_t y, int16_t w, int16_t h);
+
+  // Install the BUSY wait callback used for instrumentation
+  void beginInstrumentation();
+
+  void setRefreshMode(RefreshMode mode) { _mode = mode; }
+  RefreshMode refreshMode() const { return _mode; }
+  static const char *refreshModeName(RefreshMode mode);
+
+  // Temperature used for waveform selection, in degrees C
+  float temperature();
+  // Expected duration of a refresh in the given mode: the measured mean once
+  // the mode has been used, the datasheet estimate before
+  uint32_t refreshCostMs(RefreshMode mode) const;
+  const RefreshStats &refreshStats(RefreshMode mode) const { return _stats[mode]; }
+
+  void setAutoRefresh(bool enabled) { _autoRefresh = enabled; }
+  bool autoRefresh() const { return _autoRefresh; }
+  void setAutoThresholds(uint8_t fullTiles, uint8_t maxPartials)
+  {
+    _autoFullTiles = fullTiles;
+    _autoMaxPartials = maxPartials;
+  }
+  // Make the next full-window refresh a REFRESH_FULL one, whatever the diff
+  // and the selected mode say, to clear ghosting
+  void requestFullRefresh() { _forceFull = true; }
+  // Diff and plan of the last whole-screen write
+  const FrameDiff::Result &lastDiff() const { return _lastDiff; }
+  RefreshPlan lastPlan() const { return _lastPlan; }
+  static const char *refreshPlanName(RefreshPlan plan);
+
+  // Panel RAM shadow, rows of WIDTH / 8 bytes
+  const uint8_t *shadow() const;
+  // Incremented by every refresh, to detect frames changing under a reader
+  uint32_t frameSeq() const { return _frameSeq; }
+  // Incremented by every write into the shadow, including the chunks of a
+  // frame streamed before its refresh
+  uint32_t writeSeq() const { return _writeSeq; }
+
+private:
+  void shadowWrite(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h, bool invert, bool mirror_y);
+  RefreshMode resolveMode(bool window, const TemperatureBand *&band);
+  void refreshFast(const TemperatureBand &band);
+  void refreshA2(const TemperatureBand &band);
+  void recordRefresh(RefreshMode mode, uint32_t startMs);
+  RefreshPlan planRefresh(const uint8_t bitmap[]);
+
+  volatile RefreshMode _mode = REFRESH_FULL;
+  float _temperature = 25;
+  uint32_t _temperatureMs = 0;
+  RefreshStats _stats[REFRESH_MODE_COUNT] = {};
+  volatile uint32_t _frameSeq = 0;
+  volatile uint32_t _writeSeq = 0;
+  bool _autoRefresh = true;
+  uint8_t _autoFullTiles = AUTO_FULL_TILES;
+  uint8_t _autoMaxPartials = AUTO_MAX_PARTIALS;
+  volatile bool _forceFull = false;
+  RefreshPlan _plan = PLAN_FULL;
+  RefreshPlan _lastPlan = PLAN_FULL;
+  int16_t _planX = 0, _planY = 0, _planW = 0, _planH = 0;
+  uint8_t _partialsSinceFull = 0;
+  FrameDiff::Result _lastDiff = {};
+};
+
+#endif
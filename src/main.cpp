@@ -1,16 +1,31 @@
 #include <Arduino.h>
 #include <Fonts/FreeMonoBold18pt7b.h>
 #include <Fonts/FreeMonoBold12pt7b.h>
-#include <GxEPD2_BW.h>
 #include <SPI.h>
 #include <FS.h>
 #include <SD.h>
 
-#include "image.h"
+#include "Arena.h"
+#include "Display.h"
+#include "Benchmark.h"
+#include "EventLog.h"
+#include "FileBrowser.h"
+#include "Hal.h"
+#include "HealthMonitor.h"
+#include "ImageViewer.h"
+#include "Layout.h"
+#include "Metrics.h"
+#include "PowerManager.h"
+#include "Screens.h"
+#include "Screenshot.h"
+#include "SerialConsole.h"
+#include "Settings.h"
+#include "SpscRing.h"
+#include "UiController.h"
+#include "UiSnapshot.h"
 #include "BatteryMonitor.h"
 #include "InputManager.h"
 
-#define SPI_FQ 40000000
 // Display SPI pins (custom pins for XteinkX4, not hardware SPI defaults)
 #define EPD_SCLK 8  // SPI Clock
 #define EPD_MOSI 10 // SPI MOSI (Master Out Slave In)
@@ -19,262 +34,329 @@
 #define EPD_RST 5   // Reset
 #define EPD_BUSY 6  // Busy
 
-#define UART0_RXD 20 // Used for USB connection detection
 #define BAT_GPIO0 0 // Battery voltage
 
 #define SD_SPI_CS   12
 #define SD_SPI_MISO 7
+// An index merge holds 4 files open while the viewer opens 2 from the render
+// task, over the SD driver's default of 5
+#define SD_MAX_FILES 8
 
 static bool g_sdReady = false;
 static int rawBat = 0;
 static BatteryMonitor g_battery(BAT_GPIO0);
 static InputManager input_manager;
 
-// Display command enum
-enum DisplayCommand
+DisplayType display(DisplayPanel(EPD_CS, EPD_DC, EPD_RST, EPD_BUSY));
+
+// UiController's view of the firmware: snapshots for the render task, the
+// panel, the SD index and the sleep modes
+class FirmwareSink : public UiSink
 {
-  DISPLAY_NONE = 0,
-  DISPLAY_INITIAL,
-  DISPLAY_TEXT,
-  DISPLAY_BATTERY,
-  DISPLAY_SLEEP
+public:
+  bool publish(DisplayCommand cmd) override;
+  bool renderBusy() override;
+  void requestFullRefresh() override;
+  void hibernate() override;
+  void deepSleep() override;
+  void rebuildIndex() override;
+  void backgroundWork() override;
+  uint32_t fileCount() override;
+  uint16_t batteryMv() override;
 };
 
-volatile DisplayCommand displayCommand = DISPLAY_NONE;
+// Input, display requests and power stages; requests from any task are
+// merged until the I/O task captures them into a snapshot for the render
+// task
+static FirmwareSink g_sink;
+static UiController g_ui(g_sink);
+static SpscRing<UiSnapshot, 4> g_snapshots;
+static UiSnapshot g_current; // Snapshot being rendered, owned by the render task
+static volatile bool g_rendering = false;
+// Set by the health monitor while it re-creates the render task, holds
+// publishing off until the new task runs
+static volatile bool g_renderRestarting = false;
+
+// Scratch memory for one render (render task), rewound after every frame
+#define FRAME_ARENA_SIZE 1024
+static StaticArena<FRAME_ARENA_SIZE> g_frameArena("frame");
+
+// Heap health is sampled into the event log for long-uptime diagnostics
+#define HEAP_SAMPLE_MS 600000
+
+// SD root listing, scrolled a page at a time with Left/Right (I/O task)
+static FileBrowser g_browser;
+static volatile bool g_filesRebuild = false;
+
+// Image viewer, images are read from ImageViewer::IMAGE_DIR. Scanning
+// happens on the I/O task, streaming an image is the render itself.
+static ImageViewer g_viewer;
+static int g_viewerIndex = 0;
+
+static volatile bool g_logFlushRequested = false;
+
+// Inactivity stages are followed by g_ui on the I/O task. While idle the
+// I/O task light-sleeps for the poll period instead of waiting; the power
+// button wakes it at once, the ADC ladder buttons are seen on the next poll.
+static volatile bool g_hibernateRequested = false; // Applied by the render task
+
+// FreeRTOS tasks: I/O (SD, battery, input) feeds render (panel) through
+// g_snapshots. I/O has the higher priority so input stays responsive, the
+// render task spends most of its time sleeping in BUSY waits.
+TaskHandle_t ioTaskHandle = NULL;
+TaskHandle_t renderTaskHandle = NULL;
+#define IO_TASK_STACK 6144
+#define IO_TASK_PRIORITY 2
+#define RENDER_TASK_STACK 4096
+#define RENDER_TASK_PRIORITY 1
+#define LOOP_TASK_STACK 8192 // Arduino core default for loopTask
+
+// Heartbeat ids and timeouts; the longest render (full refresh) takes ~2s
+static int g_renderHealthId = -1;
+static int g_ioHealthId = -1;
+static int g_loopHealthId = -1;
+#define RENDER_HEARTBEAT_MS 20000
+#define IO_HEARTBEAT_MS 5000
+#define LOOP_HEARTBEAT_MS 10000
+
+// Last-known-good screen, kept across crash resets by HealthMonitor
+struct ScreenState
+{
+  uint8_t screen;
+  uint8_t viewerActive;
+  uint8_t viewerMode;
+  int16_t viewerIndex;
+};
 
-// GxEPD2 display - Using GxEPD2_426_GDEQ0426T82
-// Note: XteinkX4 has 4.26" 800x480 display
-GxEPD2_BW<GxEPD2_426_GDEQ0426T82, GxEPD2_426_GDEQ0426T82::HEIGHT> display(
-  GxEPD2_426_GDEQ0426T82(EPD_CS, EPD_DC, EPD_RST, EPD_BUSY));
+// Set when the bus clock setting changed, applied by the render task which
+// owns the panel. The SD driver keeps the clock it was mounted with, its
+// files stay open across polls, so the card takes a new clock on reboot.
+static volatile bool g_spiReconfigure = false;
 
-// FreeRTOS task for non-blocking display updates
-TaskHandle_t displayTaskHandle = NULL;
+// Panel and SD bus settings, the clock comes from Settings
+static SPISettings spiSettings()
+{
+  return SPISettings(Settings::values().spiHz, MSBFIRST, SPI_MODE0);
+}
 
-// Power button timing
-const unsigned long POWER_BUTTON_WAKEUP_MS = 1000; // Time required to confirm boot from sleep
-const unsigned long POWER_BUTTON_SLEEP_MS = 1000;  // Time required to enter sleep mode
+// Push the settings into the running firmware, at boot and on every change.
+// Timings and debug output read Settings::values() where they are used.
+static void applySettings()
+{
+  const SettingsValues &s = Settings::values();
+  g_ui.power().setTimeouts(s.idleMs, s.hibernateMs, s.autoSleepMs);
+  g_ui.setSleepHoldMs(s.powerSleepMs);
+  display.epd2.setRefreshMode((RefreshMode) s.refreshMode);
+  display.epd2.setAutoRefresh(s.autoRefresh);
+  display.epd2.setAutoThresholds(s.autoFullTiles, s.autoMaxPartials);
+  g_spiReconfigure = true;
+}
 
 // Check if charging
 bool isCharging()
 {
-  // U0RXD/GPIO20 reads HIGH when USB is connected
-  return digitalRead(UART0_RXD) == HIGH;
+  return Hal::usbConnected();
 }
 
-// Draw battery information on display
-void drawBatteryInfo()
+// Benchmark hook: the welcome screen with the snapshot being rendered
+static void drawBenchmarkScreen()
 {
-  display.setFont(&FreeMonoBold12pt7b);
-  display.setCursor(20, 160);
+  g_frameArena.reset(); // Each iteration is a frame
+  Screens::drawInitial(g_current, g_frameArena);
+}
 
-  bool charging = isCharging();
-  display.printf("Power: %s", charging ? "Charging" : "Battery");
+// Benchmark hook: a single benchmark render refreshes the panel many
+// times, beat after every case instead of once per render
+static void benchmarkCaseDone()
+{
+  HealthMonitor::beat(g_renderHealthId);
+}
 
-  display.setCursor(40, 200);
-  display.printf("Raw: %i", g_battery.readRawMillivolts());
-  display.setCursor(40, 240);
-  display.printf("Volts: %.2f V", g_battery.readVolts());
-  display.setCursor(40, 280);
-  display.printf("Charge: %i%%", g_battery.readPercentage());
+// Remember the screen just rendered so a crash reset can restore it
+static void saveScreenState(const UiSnapshot &snap)
+{
+  if (snap.command == DISPLAY_SLEEP || UiController::isBenchmark(snap.command))
+  {
+    return;
+  }
+  ScreenState state = {(uint8_t) snap.command, snap.viewerActive, (uint8_t) snap.viewerMode, snap.viewerIndex};
+  HealthMonitor::saveState(&state, sizeof(state));
 }
 
-// Draw up to top file names from SD on the display, below battery info
-static void drawSdTopFiles()
+// Redraw the last-known-good screen after a crash or a display task restart
+static void restoreScreenState()
 {
-  // Layout constants aligned with drawBatteryInfo() block
-  const int startX = 40;
-  const int startY = 350;
-  const int lineHeight = 26;
-  const int maxLines = 5;
-  const int maxChars = 30;
+  ScreenState state;
+  UiState &ui = g_ui.state();
+  if (HealthMonitor::loadState(&state, sizeof(state)) && state.viewerActive)
+  {
+    ui.viewerActive = true;
+    ui.viewerMode = (ImageViewer::Mode) state.viewerMode;
+    ui.viewerRescan = true;
+    ui.viewerStep = state.viewerIndex; // Applied after the rescan
+    g_ui.request(DISPLAY_IMAGE);
+  }
+  else
+  {
+    // Partial screens need a full refresh underneath after a panel reset
+    g_ui.request(DISPLAY_INITIAL);
+  }
+}
 
-  display.setFont(&FreeMonoBold12pt7b);
+static void setPartialWindow(const Layout::Rect &window)
+{
+  display.setPartialWindow(window.x, window.y, window.w, window.h);
+}
 
-  display.setCursor(20, 320);
-  display.print("Top 5 files on SD:");
+// Render one snapshot to the panel
+static void render(const UiSnapshot &snap)
+{
+  DisplayCommand cmd = snap.command;
+  unsigned long renderStart = Hal::millis();
+  EventLog::log(EVT_RENDER_START, cmd);
 
-  auto drawTruncated = [&](int lineIdx, const char *text)
+  if (cmd == DISPLAY_INITIAL)
   {
-    // Render a single line, truncating with ellipsis if needed
-    String s(text ? text : "");
-    if ((int) s.length() > maxChars)
+    METRICS_SCOPE(METRIC_RENDER_INITIAL);
+    // Use full window for initial welcome screen
+    display.setFullWindow();
+    display.firstPage();
+    do
     {
-      s.remove(maxChars - 1);
-      s += "…";
-    }
-    display.setCursor(startX, startY + lineIdx * lineHeight);
-    display.print(s);
-  };
-
-  // Ensure SD is initialized using global flag; try to init if needed
-  if (!g_sdReady)
+      display.fillScreen(GxEPD_WHITE);
+      Screens::drawInitial(snap, g_frameArena);
+    } while (display.nextPage());
+  }
+  else if (cmd == DISPLAY_TEXT)
   {
-    if (SD.begin(SD_SPI_CS, SPI, SPI_FQ))
+    METRICS_SCOPE(METRIC_RENDER_TEXT);
+    // Use partial refresh for text updates
+    setPartialWindow(Layout::TEXT_WINDOW);
+    display.firstPage();
+    do
     {
-      g_sdReady = true;
-    }
+      display.fillScreen(GxEPD_WHITE);
+      Screens::drawPressedButtons(snap);
+      Screens::drawBattery(snap);
+    } while (display.nextPage());
   }
-
-  if (!g_sdReady)
+  else if (cmd == DISPLAY_BATTERY)
   {
-    drawTruncated(0, "No card");
-    return;
+    METRICS_SCOPE(METRIC_RENDER_BATTERY);
+    // Use partial refresh for battery updates
+    setPartialWindow(Layout::BATTERY_WINDOW);
+    display.firstPage();
+    do
+    {
+      display.fillScreen(GxEPD_WHITE);
+      Screens::drawBattery(snap);
+    } while (display.nextPage());
   }
-
-  File root = SD.open("/");
-  if (!root || !root.isDirectory())
+  else if (cmd == DISPLAY_FILES)
   {
-    drawTruncated(0, "No card");
-    if (root) root.close();
-    return;
+    METRICS_SCOPE(METRIC_RENDER_FILES);
+    // Use partial refresh for the file list
+    setPartialWindow(Layout::FILES_WINDOW);
+    display.firstPage();
+    do
+    {
+      display.fillScreen(GxEPD_WHITE);
+      Screens::drawFiles(snap, g_frameArena);
+    } while (display.nextPage());
   }
-
-  int count = 0;
-  for (File f = root.openNextFile(); f && count < maxLines; f = root.openNextFile())
+  else if (cmd == DISPLAY_IMAGE)
   {
-    if (!f.isDirectory())
+    METRICS_SCOPE(METRIC_RENDER_IMAGE);
+    if (snap.imageCount > 0 && g_viewer.show(snap.viewerIndex, snap.viewerMode))
+    {
+      const ImageViewer::Timing &t = g_viewer.lastTiming();
+      EventLog::log(EVT_IMAGE_SHOWN, snap.viewerIndex, t.transferMs, t.refreshMs);
+      Serial.printf("Image %s (%s): transfer %lums, refresh %lums, %u bytes read\n", g_viewer.lastName(),
+                    snap.viewerMode == ImageViewer::MODE_STREAM ? "stream" : "buffered", t.transferMs, t.refreshMs,
+                    (unsigned) t.bytesRead);
+    }
+    else
     {
-      const char *name = f.name();
-      // Ensure only name + extension, no leading path
-      const char *basename = name;
-      if (basename)
+      display.setFullWindow();
+      display.firstPage();
+      do
       {
-        const char *slash = strrchr(basename, '/');
-        if (slash && *(slash + 1))
-          basename = slash + 1;
-      }
-      drawTruncated(count, basename ? basename : "");
-      count++;
+        display.fillScreen(GxEPD_WHITE);
+        display.setFont(&FreeMonoBold12pt7b);
+        display.setCursor(Layout::NO_IMAGES.x, Layout::NO_IMAGES.baseline);
+        display.printf("No images in %s", ImageViewer::IMAGE_DIR);
+      } while (display.nextPage());
     }
-    f.close();
   }
-
-  if (count == 0)
+  else if (cmd == DISPLAY_BENCHMARK)
   {
-    drawTruncated(0, "Empty");
+    Benchmark::run(Serial, drawBenchmarkScreen, benchmarkCaseDone);
   }
-
-  root.close();
+  else if (cmd == DISPLAY_BENCHMARK_REFRESH)
+  {
+    Benchmark::runRefresh(Serial, drawBenchmarkScreen, benchmarkCaseDone);
+  }
+  else if (cmd == DISPLAY_SLEEP)
+  {
+    METRICS_SCOPE(METRIC_RENDER_SLEEP);
+    // Use full window for sleep screen
+    display.setFullWindow();
+    display.firstPage();
+    do
+    {
+      display.fillScreen(GxEPD_WHITE);
+      // Header font
+      display.setFont(&FreeMonoBold18pt7b);
+      display.setCursor(Layout::SLEEPING.x, Layout::SLEEPING.baseline);
+      display.print("Sleeping...");
+    } while (display.nextPage());
+  }
+  METRICS_END_RENDER();
+  EventLog::log(EVT_RENDER_END, cmd, Hal::millis() - renderStart);
+  saveScreenState(snap);
 }
 
-// Display update task running on separate core
-void displayUpdateTask(void *parameter)
+// Render task: consumes snapshots from the I/O task, only drives the panel
+void renderTask(void *parameter)
 {
   while (1)
   {
-    if (displayCommand != DISPLAY_NONE)
+    if (g_spiReconfigure)
+    {
+      g_spiReconfigure = false;
+      display.epd2.selectSPI(SPI, spiSettings());
+    }
+    if (g_hibernateRequested)
     {
-      DisplayCommand cmd = displayCommand;
-      displayCommand = DISPLAY_NONE;
+      // The next refresh wakes the controller through a hardware reset
+      g_rendering = true;
+      display.hibernate();
+      g_rendering = false;
+      g_hibernateRequested = false;
+    }
 
-      if (cmd == DISPLAY_INITIAL)
-      {
-        // Use full window for initial welcome screen
-        display.setFullWindow();
-        display.firstPage();
-        do
-        {
-          display.fillScreen(GxEPD_WHITE);
-
-          // Header font
-          display.setFont(&FreeMonoBold18pt7b);
-          display.setCursor(20, 50);
-          display.print("Xteink X4 Sample");
-
-          // Button text with smaller font
-          display.setFont(&FreeMonoBold12pt7b);
-          display.setCursor(20, 100);
-          bool anyPressed = false;
-          for (int i = 0; i <= 6; i++)
-          {
-            if (input_manager.isPressed(i))
-            {
-              if (!anyPressed)
-              {
-                display.print("Pressing:");
-                anyPressed = true;
-              }
-              display.print(" ");
-              display.print(InputManager::getButtonName(i));
-            }
-          }
-          if (!anyPressed)
-          {
-            display.print("Press any button");
-          }
-
-          // Draw battery information
-          drawBatteryInfo();
-          // Draw top 3 SD files below the battery block
-          drawSdTopFiles();
-
-          // Draw image at bottom right
-          int16_t imgWidth = 263;
-          int16_t imgHeight = 280;
-          int16_t imgMargin = 20;
-          int16_t imgX = 480 - imgMargin - imgWidth;
-          int16_t imgY = 800 - imgMargin - imgHeight;
-          display.drawBitmap(imgX, imgY, dr_mario, imgWidth, imgHeight, GxEPD_BLACK);
-        } while (display.nextPage());
-      }
-      else if (cmd == DISPLAY_TEXT)
-      {
-        // Use partial refresh for text updates
-        display.setPartialWindow(0, 75, display.width(), 225);
-        display.firstPage();
-        do
-        {
-          display.fillScreen(GxEPD_WHITE);
-          display.setFont(&FreeMonoBold12pt7b);
-          display.setCursor(20, 100);
-          bool anyPressed = false;
-          for (int i = 0; i <= 6; i++)
-          {
-            if (input_manager.isPressed(i))
-            {
-              if (!anyPressed)
-              {
-                display.print("Pressing:");
-                anyPressed = true;
-              }
-              display.print(" ");
-              display.print(InputManager::getButtonName(i));
-            }
-          }
-          if (!anyPressed)
-          {
-            display.print("Press any button");
-          }
-          drawBatteryInfo();
-        } while (display.nextPage());
-      }
-      else if (cmd == DISPLAY_BATTERY)
-      {
-        // Use partial refresh for battery updates
-        display.setPartialWindow(0, 135, display.width(), 200);
-        display.firstPage();
-        do
-        {
-          display.fillScreen(GxEPD_WHITE);
-          drawBatteryInfo();
-        } while (display.nextPage());
-      }
-      else if (cmd == DISPLAY_SLEEP)
+    // Set before the pop so renderBusy() has no gap between a snapshot
+    // leaving the ring and its refresh starting
+    g_rendering = true;
+    if (g_snapshots.pop(g_current))
+    {
+      // A newer snapshot of the same screen supersedes this one
+      const UiSnapshot *next;
+      while ((next = g_snapshots.peek()) && next->command == g_current.command)
       {
-        // Use full window for sleep screen
-        display.setFullWindow();
-        display.firstPage();
-        do
-        {
-          display.fillScreen(GxEPD_WHITE);
-          // Header font
-          display.setFont(&FreeMonoBold18pt7b);
-          display.setCursor(120, 380);
-          display.print("Sleeping...");
-        } while (display.nextPage());
+        g_snapshots.pop(g_current);
       }
+      render(g_current);
+      g_rendering = false;
+      g_frameArena.reset();
     }
-    vTaskDelay(10 / portTICK_PERIOD_MS);
+    else
+    {
+      g_rendering = false;
+      // Woken by the I/O task on push, times out to keep the heartbeat going
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+    }
+    HealthMonitor::beat(g_renderHealthId);
   }
 }
 
@@ -284,9 +366,9 @@ void verifyWakeupLongPress()
   bool abortBoot = false;
   input_manager.update();
 
-  while (input_manager.getHeldTime() < POWER_BUTTON_WAKEUP_MS)
+  while (input_manager.getHeldTime() < Settings::values().powerWakeupMs)
   {
-    delay(10);
+    Hal::delay(10);
     input_manager.update();
     if (!input_manager.isPressed(InputManager::BTN_POWER))
     {
@@ -297,108 +379,204 @@ void verifyWakeupLongPress()
 
   if (abortBoot)
   {
-    // Button released too early. Returning to sleep.
-    // IMPORTANT: Re-arm the wakeup trigger before sleeping again
-    esp_deep_sleep_enable_gpio_wakeup(1ULL << InputManager::POWER_BUTTON_PIN, ESP_GPIO_WAKEUP_GPIO_LOW);
-    esp_deep_sleep_start();
+    // Button released too early. Returning to sleep, which re-arms the
+    // wakeup trigger.
+    Hal::deepSleep();
   }
 }
 
-// Enter deep sleep mode
-void enterDeepSleep()
+static void startRenderTask()
 {
-  displayCommand = DISPLAY_SLEEP;
-  delay(2000); // Allow Serial buffer to empty and display to update
+  xTaskCreate(renderTask,           // Task function
+              "Render",             // Task name
+              RENDER_TASK_STACK,    // Stack size
+              NULL,                 // Parameters
+              RENDER_TASK_PRIORITY, // Priority
+              &renderTaskHandle     // Task handle
+  );
+  Metrics::watchTask(renderTaskHandle, "render", RENDER_TASK_STACK);
+}
 
-  // Enable Wakeup on LOW (button press)
-  esp_deep_sleep_enable_gpio_wakeup(1ULL << InputManager::POWER_BUTTON_PIN, ESP_GPIO_WAKEUP_GPIO_LOW);
+// Render subsystem recovery, called by the health monitor when the render
+// task stops beating (e.g. stuck on BUSY). If the task died holding the SPI
+// bus the next stall escalates to a full restart.
+static void restartRenderTask()
+{
+  // The I/O task runs during the panel reset delays below
+  g_renderRestarting = true;
+  vTaskDelete(renderTaskHandle);
+  renderTaskHandle = NULL;
+  // The task may have died inside render(): nothing renders any more
+  g_rendering = false;
+  g_frameArena.reset();
+
+  // Hardware reset of the panel controller
+  display.init(115200, true, 2, false, SPI, spiSettings());
+  display.setRotation(Layout::ROTATION);
+  display.setTextColor(GxEPD_BLACK);
 
-  // Enter Deep Sleep
-  esp_deep_sleep_start();
+  startRenderTask();
+  restoreScreenState();
+  g_renderRestarting = false;
+  // The ring has a single producer, the I/O task publishes on its next poll
+  g_ui.forcePublish();
 }
 
-void setup()
+// Wake the render task, if there is one: pushed work is picked up by a
+// task created later as well
+static void notifyRender()
 {
-  // Initialize inputs
-  input_manager.begin();
-
-  // Check if boot was triggered by the Power Button (Deep Sleep Wakeup)
-  // If triggered by RST pin or Battery insertion, this will be false, allowing normal boot.
-  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO)
+  TaskHandle_t task = renderTaskHandle;
+  if (task)
   {
-    verifyWakeupLongPress();
+    xTaskNotifyGive(task);
   }
+}
 
-  Serial.begin(115200);
+static uint16_t batteryMv()
+{
+  return g_battery.readVolts() * 1000;
+}
 
-  // Wait for serial monitor
-  unsigned long start = millis();
-  while (!Serial && (millis() - start) < 3000)
+// Serial "metrics" command
+static void metricsCommand(const char *args)
+{
+  if (strcmp(args, "reset") == 0)
   {
-    delay(10);
+    Metrics::reset();
+    Serial.println("Metrics reset");
+    return;
   }
+  Metrics::dump(Serial);
+  g_frameArena.printStats(Serial);
+}
 
-  if (Serial)
+// Serial "log" command
+static void logCommand(const char *args)
+{
+  if (strcmp(args, "flush") == 0)
   {
-    // delay for monitor to start reading
-    delay(1000);
+    // Flushed by the I/O task, the only event log consumer
+    g_logFlushRequested = true;
   }
+  EventLog::printStats(Serial);
+}
 
-
-  Serial.println("\n=================================");
-  Serial.println("  xteink x4 sample");
-  Serial.println("=================================");
-  Serial.println();
-
-  // Initialize SPI with custom pins
-  SPI.begin(EPD_SCLK,SD_SPI_MISO, EPD_MOSI, EPD_CS);
-  // Initialize display
-  SPISettings spi_settings(SPI_FQ, MSBFIRST, SPI_MODE0);
-  display.init(115200, true, 2, false, SPI, spi_settings);
-
-  // SD Card Initialization
-  if (!SD.begin(SD_SPI_CS, SPI, SPI_FQ))
+// Serial "health" command
+static void healthCommand(const char *args)
+{
+  if (strcmp(args, "erase-coredump") == 0)
   {
-    Serial.print("\n SD card not detected\n");
+    HealthMonitor::eraseCoreDump();
   }
-  else
+  HealthMonitor::printStatus(Serial);
+}
+
+// Serial "files" command
+static void filesCommand(const char *args)
+{
+  if (strcmp(args, "rebuild") == 0)
   {
-    Serial.print("\n SD card detected\n");
-    g_sdReady = true;
+    // Picked up by the I/O task
+    g_filesRebuild = true;
   }
+  Serial.printf("SD index: %u entries%s, showing from %u\n", (unsigned) g_browser.count(),
+                g_browser.indexing() ? " (rebuilding)" : "", (unsigned) g_ui.state().fileTop);
+}
 
-  // Setup display properties
-  display.setRotation(3); // 270 degrees
-  display.setTextColor(GxEPD_BLACK);
+// Serial "bench" command, runs on the render task
+static void benchCommand(const char *args)
+{
+  g_ui.request(strcmp(args, "refresh") == 0 ? DISPLAY_BENCHMARK_REFRESH : DISPLAY_BENCHMARK);
+}
 
-  Serial.println("Display initialized");
+// Serial "screenshot" command, streams the panel contents
+static void screenshotCommand(const char *args)
+{
+  Screenshot::dump(Serial);
+}
 
+// Serial "refresh" command: select the waveform for all refreshes, or turn
+// the diff-driven choice of full-window updates on and off
+static void refreshCommand(const char *args)
+{
+  // Through the settings, so "config save" keeps the choice
+  if (strncmp(args, "auto", 4) == 0)
+  {
+    bool on = strcmp(args + 4, " on") == 0;
+    if (!on && strcmp(args + 4, " off") != 0)
+    {
+      Serial.println("Usage: refresh auto on|off");
+      return;
+    }
+    Settings::set("auto_refresh", on);
+  }
+  for (int mode = 0; mode < REFRESH_MODE_COUNT; mode++)
+  {
+    if (strcmp(args, X4Panel::refreshModeName((RefreshMode) mode)) == 0)
+    {
+      Settings::set("refresh_mode", mode);
+    }
+  }
 
-  // Draw initial welcome screen
-  displayCommand = DISPLAY_INITIAL;
+  Serial.printf("Refresh mode: %s, temperature %.1f C\n", X4Panel::refreshModeName(display.epd2.refreshMode()),
+                display.epd2.temperature());
+  for (int mode = 0; mode < REFRESH_MODE_COUNT; mode++)
+  {
+    const X4Panel::RefreshStats &stats = display.epd2.refreshStats((RefreshMode) mode);
+    Serial.printf("  %-8s %4u refreshes, last %4u ms, cost %4u ms\n", X4Panel::refreshModeName((RefreshMode) mode),
+                  (unsigned) stats.count, (unsigned) stats.lastMs,
+                  (unsigned) display.epd2.refreshCostMs((RefreshMode) mode));
+  }
 
-  // Create display update task on core 0 (main loop runs on core 1)
-  xTaskCreatePinnedToCore(displayUpdateTask,  // Task function
-                          "DisplayUpdate",    // Task name
-                          4096,               // Stack size
-                          NULL,               // Parameters
-                          1,                  // Priority
-                          &displayTaskHandle, // Task handle
-                          0                   // Core 0
-  );
+  const FrameDiff::Result &diff = display.epd2.lastDiff();
+  Serial.printf("Auto refresh: %s, last diff %u pixels in %u tiles, %u us, plan %s\n",
+                display.epd2.autoRefresh() ? "on" : "off", (unsigned) diff.total,
+                (unsigned) __builtin_popcount(diff.tileMask), (unsigned) diff.micros,
+                X4Panel::refreshPlanName(display.epd2.lastPlan()));
+}
 
-  Serial.println("Display task created");
-  Serial.println("Setup complete!\n");
+// Serial "power" command
+static void powerCommand(const char *args)
+{
+  g_ui.power().printStatus(Serial, Hal::millis());
+  Serial.printf("Battery: %u mV%s\n", (unsigned) batteryMv(), isCharging() ? ", USB powered (stages held)" : "");
+}
 
-  // Avoid entering main loop while still holding power on button
-  while (input_manager.isPressed(InputManager::BTN_POWER))
+// Serial "config" command: list, change, save or reset the settings
+static void configCommand(const char *args)
+{
+  if (strcmp(args, "save") == 0)
   {
-    delay(10);
-    input_manager.update();
+    Serial.println(Settings::save() ? "Settings saved" : "Settings save failed");
+    return;
   }
+  if (strcmp(args, "reset") == 0)
+  {
+    Settings::reset();
+  }
+  else if (*args)
+  {
+    char key[16];
+    const char *value = strchr(args, ' ');
+    size_t len = value ? value - args : 0;
+    if (!value || len >= sizeof(key))
+    {
+      Serial.println("Usage: config [<key> <value> | save | reset]");
+      return;
+    }
+    memcpy(key, args, len);
+    key[len] = '\0';
+    if (!Settings::set(key, value + 1))
+    {
+      Serial.printf("Bad setting or value: %s\n", args);
+      return;
+    }
+  }
+  Serial.println("Settings (* changed from default, 'config save' keeps them):");
+  Settings::print(Serial);
 }
 
-#ifdef DEBUG_IO
 void debugIO()
 {
   // log each button
@@ -429,29 +607,330 @@ void debugIO()
 
   // SD card
 }
-#endif
 
+// Record button edges in the event log
+static void logButtons()
+{
+  for (int i = 0; i <= 6; i++)
+  {
+    if (input_manager.wasPressed(i))
+    {
+      EventLog::log(EVT_BUTTON_DOWN, i);
+    }
+    if (input_manager.wasReleased(i))
+    {
+      EventLog::log(EVT_BUTTON_UP, i, input_manager.getHeldTime());
+    }
+  }
+}
 
-void loop()
+// Sample the buttons and log their edges, g_ui.poll() turns them into
+// display requests
+static void sampleInput()
 {
   input_manager.update();
-
   if (input_manager.wasAnyPressed() || input_manager.wasAnyReleased())
   {
-    displayCommand = DISPLAY_TEXT;
+    logButtons();
+    if (Settings::values().debugIo)
+    {
+      debugIO();
+    }
+  }
+}
 
-#ifdef DEBUG_IO
-    debugIO();
-#endif
+// Capture everything a render of cmd needs
+static void captureSnapshot(DisplayCommand cmd, UiSnapshot &snap)
+{
+  memset(&snap, 0, sizeof(snap));
+  snap.command = cmd;
+  snap.createdMs = Hal::millis();
 
-    if (input_manager.wasReleased(InputManager::BTN_POWER)) {
-      // Power button long pressed => go to sleep
-      if (input_manager.getHeldTime() > POWER_BUTTON_SLEEP_MS) {
-        Serial.printf("Power button released after %lums. Entering deep sleep.\n", input_manager.getHeldTime());
-        enterDeepSleep();
-      }
+  for (int i = 0; i <= 6; i++)
+  {
+    if (input_manager.isPressed(i)) snap.pressedMask |= 1 << i;
+  }
+
+  snap.charging = isCharging();
+  snap.batteryRawMv = g_battery.readRawMillivolts();
+  snap.batteryVolts = g_battery.readVolts();
+  snap.batteryPercent = g_battery.readPercentage();
+
+  // Retry a card inserted after boot when the listing is shown
+  if (!g_sdReady && (cmd == DISPLAY_INITIAL || cmd == DISPLAY_FILES) &&
+      SD.begin(SD_SPI_CS, SPI, Settings::values().spiHz, "/sd", SD_MAX_FILES))
+  {
+    g_sdReady = true;
+    EventLog::log(EVT_SD_MOUNT, g_sdReady);
+    g_browser.open("/");
+  }
+
+  snap.sdReady = g_sdReady;
+  snap.indexing = g_browser.indexing();
+  snap.indexedEntries = g_browser.indexedEntries();
+  snap.fileTotal = g_browser.count();
+  UiState &ui = g_ui.state();
+  if (ui.fileTop >= snap.fileTotal) ui.fileTop = 0;
+  snap.fileTop = ui.fileTop;
+  if (cmd == DISPLAY_INITIAL || cmd == DISPLAY_FILES || UiController::isBenchmark(cmd))
+  {
+    snap.fileCount = g_browser.read(ui.fileTop, snap.files, FILE_LINES);
+  }
+
+  if (cmd == DISPLAY_IMAGE)
+  {
+    if (ui.viewerRescan)
+    {
+      ui.viewerRescan = false;
+      g_viewerIndex = 0;
+      if (g_sdReady) g_viewer.scan();
+    }
+    int count = g_viewer.count();
+    g_viewerIndex += ui.viewerStep;
+    ui.viewerStep = 0;
+    if (count > 0)
+    {
+      g_viewerIndex %= count;
+      if (g_viewerIndex < 0) g_viewerIndex += count;
+    }
+    snap.imageCount = count;
+  }
+  snap.viewerActive = ui.viewerActive;
+  snap.viewerMode = ui.viewerMode;
+  snap.viewerIndex = g_viewerIndex;
+}
+
+bool FirmwareSink::publish(DisplayCommand cmd)
+{
+  UiSnapshot snap;
+  captureSnapshot(cmd, snap);
+  if (!g_snapshots.push(snap))
+  {
+    return false;
+  }
+  notifyRender();
+  return true;
+}
+
+bool FirmwareSink::renderBusy()
+{
+  return g_rendering || g_renderRestarting || g_hibernateRequested || g_snapshots.size() > 0;
+}
+
+void FirmwareSink::requestFullRefresh()
+{
+  display.epd2.requestFullRefresh();
+}
+
+void FirmwareSink::hibernate()
+{
+  g_hibernateRequested = true;
+  notifyRender();
+}
+
+void FirmwareSink::deepSleep()
+{
+  Serial.flush();
+  EventLog::flush();
+
+  // Wakes on LOW (button press)
+  Hal::deepSleep();
+}
+
+void FirmwareSink::rebuildIndex()
+{
+  // Picked up by backgroundWork()
+  g_filesRebuild = true;
+}
+
+uint32_t FirmwareSink::fileCount()
+{
+  return g_browser.count();
+}
+
+uint16_t FirmwareSink::batteryMv()
+{
+  return ::batteryMv();
+}
+
+// One bounded unit of SD index or event log work
+void FirmwareSink::backgroundWork()
+{
+  static unsigned long lastLogFlush = 0;
+  static unsigned long lastHeapSample = 0;
+
+  if (Hal::millis() - lastHeapSample > HEAP_SAMPLE_MS)
+  {
+    lastHeapSample = Hal::millis();
+    EventLog::log(EVT_HEAP, ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap());
+  }
+
+  if (g_filesRebuild)
+  {
+    g_filesRebuild = false;
+    g_browser.rebuild();
+  }
+  else if (g_browser.busy())
+  {
+    // Redraw the list when the index is done, a check that found no change
+    // leaves it as is
+    bool indexing = g_browser.indexing();
+    if (!g_browser.step() && indexing && !g_ui.state().viewerActive)
+    {
+      g_ui.request(DISPLAY_FILES);
     }
   }
+  else if (g_logFlushRequested || EventLog::pending() >= EventLog::SLOTS / 4 || Hal::millis() - lastLogFlush > 30000)
+  {
+    // Flush lazily while idle, flash writes stall the CPU
+    g_logFlushRequested = false;
+    EventLog::flush();
+    lastLogFlush = Hal::millis();
+  }
+}
+
+// I/O task: input, battery and SD card work, publishes snapshots for the
+// render task. Never touches the panel, so a slow card read cannot stall a
+// refresh and a refresh cannot stall input.
+void ioTask(void *parameter)
+{
+  while (1)
+  {
+    HealthMonitor::beat(g_ioHealthId);
+    sampleInput();
+    g_ui.poll(input_manager, isCharging(), Settings::values().ioPollMs);
+  }
+}
+
+void setup()
+{
+  // Initialize inputs
+  input_manager.begin();
+  // Before the wake-up check, which uses the power button timing
+  Settings::begin();
+
+  // Check if boot was triggered by the Power Button (Deep Sleep Wakeup)
+  // If triggered by RST pin or Battery insertion, this will be false, allowing normal boot.
+  if (Hal::wokeByButton())
+  {
+    verifyWakeupLongPress();
+  }
+
+  EventLog::begin();
+  HealthMonitor::begin();
+  bool wokeFromSleep = g_ui.power().begin(batteryMv());
+  bool recovering = HealthMonitor::crashReset();
+
+  Serial.begin(115200);
+
+  // Wait for serial monitor, skipped when recovering from a crash
+  unsigned long start = Hal::millis();
+  while (!recovering && !Serial && (Hal::millis() - start) < 3000)
+  {
+    Hal::delay(10);
+  }
+
+  if (Serial && !recovering)
+  {
+    // delay for monitor to start reading
+    Hal::delay(1000);
+  }
+
+
+  Serial.println("\n=================================");
+  Serial.println("  xteink x4 sample");
+  Serial.println("=================================");
+  Serial.println();
+  if (wokeFromSleep)
+  {
+    const PowerManager::StageStats &sleep = g_ui.power().stats(POWER_DEEP_SLEEP);
+    Serial.printf("Woke after %u ms of deep sleep, battery %d mV lower\n", (unsigned) sleep.totalMs,
+                  (int) sleep.totalMvDrop);
+  }
+
+  // Initialize SPI with custom pins
+  SPI.begin(EPD_SCLK,SD_SPI_MISO, EPD_MOSI, EPD_CS);
+  // Initialize display
+  display.init(115200, true, 2, false, SPI, spiSettings());
+  display.epd2.beginInstrumentation();
+  applySettings();
+  Settings::onChange(applySettings);
+
+  // SD Card Initialization
+  if (!SD.begin(SD_SPI_CS, SPI, Settings::values().spiHz, "/sd", SD_MAX_FILES))
+  {
+    Serial.print("\n SD card not detected\n");
+  }
+  else
+  {
+    Serial.print("\n SD card detected\n");
+    g_sdReady = true;
+  }
+  EventLog::log(EVT_SD_MOUNT, g_sdReady);
+  if (g_sdReady)
+  {
+    g_browser.open("/");
+  }
+
+  // Setup display properties
+  display.setRotation(Layout::ROTATION); // 270 degrees
+  display.setTextColor(GxEPD_BLACK);
+
+  Serial.println("Display initialized");
 
-  delay(50);
+
+  if (recovering)
+  {
+    // Restore the last-known-good screen instead of the welcome screen
+    Serial.printf("Recovering from crash reset #%u\n", (unsigned) HealthMonitor::crashCount());
+    restoreScreenState();
+  }
+  else
+  {
+    // Draw initial welcome screen
+    g_ui.request(DISPLAY_INITIAL);
+  }
+
+  // Avoid starting input handling while still holding power on button
+  while (input_manager.isPressed(InputManager::BTN_POWER))
+  {
+    Hal::delay(10);
+    input_manager.update();
+  }
+
+  g_ui.begin();
+
+  // Create the render and I/O tasks (the ESP32-C3 has a single core)
+  startRenderTask();
+  xTaskCreate(ioTask, "IO", IO_TASK_STACK, NULL, IO_TASK_PRIORITY, &ioTaskHandle);
+
+  Serial.println("Render and I/O tasks created");
+
+  g_renderHealthId = HealthMonitor::add("render", RENDER_HEARTBEAT_MS, restartRenderTask);
+  g_ioHealthId = HealthMonitor::add("io", IO_HEARTBEAT_MS, NULL);
+  g_loopHealthId = HealthMonitor::add("loop", LOOP_HEARTBEAT_MS, NULL);
+
+  Metrics::watchTask(ioTaskHandle, "io", IO_TASK_STACK);
+  Metrics::watchTask(xTaskGetCurrentTaskHandle(), "loop", LOOP_TASK_STACK);
+  SerialConsole::add({"metrics", "dump render/IO metrics, 'metrics reset' clears them", metricsCommand});
+  SerialConsole::add({"log", "event log status, 'log flush' writes pending events to flash", logCommand});
+  SerialConsole::add({"health", "task heartbeats and core dump, 'health erase-coredump' clears it", healthCommand});
+  SerialConsole::add({"files", "SD index status, 'files rebuild' re-indexes the card root", filesCommand});
+  SerialConsole::add({"bench", "benchmark drawing primitives, 'bench refresh' times each waveform, prints JSON",
+                      benchCommand});
+  SerialConsole::add({"refresh", "waveform status, 'refresh full|fast|partial|a2' selects one, 'refresh auto on|off'",
+                      refreshCommand});
+  SerialConsole::add({"power", "inactivity stage, time and battery drop per stage", powerCommand});
+  SerialConsole::add({"config", "settings, 'config <key> <value>' changes one, 'config save|reset'", configCommand});
+  SerialConsole::add({"screenshot", "dump the panel contents, decode with tools/screenshot.py", screenshotCommand});
+  Serial.println("Setup complete!\n");
+}
+
+// The Arduino loop only serves the serial console, input and display work
+// run on the I/O and render tasks
+void loop()
+{
+  HealthMonitor::beat(g_loopHealthId);
+  SerialConsole::poll();
+  Hal::delay(50);
 }
@@ -0,0 +1,346 @@
+// Scripted timelines through the I/O task logic: button scripts go in, the
+// refreshes handed to the render task, their latencies and the power
+// decisions come out. Runs on the host: pio test -e native
+
+#include <unity.h>
+#include <vector>
+
+#include "FakeBoard.h"
+#include "Hal.h"
+#include "InputManager.h"
+#include "UiController.h"
+
+static const uint32_t POLL_MS = 50;        // io_poll_ms default
+static const uint32_t FULL_MS = 1600;      // Full refresh on the panel
+static const uint32_t PARTIAL_MS = 600;    // Partial window refresh
+static const uint32_t IDLE_MS = 30000;     // idle_ms default
+static const uint32_t HIBERNATE_MS = 120000;
+static const uint32_t SLEEP_MS = 900000;
+static const uint32_t SLEEP_HOLD_MS = 1000; // sleep_ms default
+
+struct Refresh
+{
+  DisplayCommand cmd;
+  uint32_t atMs;
+  uint32_t fileTop;
+};
+
+// Stands in for the render task: records every publish and keeps the panel
+// busy for the refresh time of the screen. Until rejectUntil the snapshot
+// ring counts as full.
+class RecordingSink final : public UiSink
+{
+public:
+  bool publish(DisplayCommand cmd) override
+  {
+    if ((int32_t) (Hal::millis() - rejectUntil) < 0)
+    {
+      return false;
+    }
+    refreshes.push_back({cmd, Hal::millis(), ui->state().fileTop});
+    bool full = cmd == DISPLAY_INITIAL || cmd == DISPLAY_IMAGE || cmd == DISPLAY_SLEEP;
+    busyUntil = Hal::millis() + (full ? FULL_MS : PARTIAL_MS);
+    return true;
+  }
+  bool renderBusy() override { return (int32_t) (Hal::millis() - busyUntil) < 0; }
+  void requestFullRefresh() override { fullRefreshes++; }
+  void hibernate() override { hibernations++; }
+  void deepSleep() override
+  {
+    deepSleeps++;
+    deepSleepAtMs = Hal::millis();
+  }
+  void rebuildIndex() override { rebuilds++; }
+  void backgroundWork() override {}
+  uint32_t fileCount() override { return 42; }
+  uint16_t batteryMv() override { return 3900; }
+
+  UiController *ui = nullptr;
+  std::vector<Refresh> refreshes;
+  uint32_t busyUntil = 0;
+  uint32_t rejectUntil = 0;
+  uint32_t deepSleepAtMs = 0;
+  int fullRefreshes = 0;
+  int hibernations = 0;
+  int deepSleeps = 0;
+  int rebuilds = 0;
+};
+
+static RecordingSink *g_sink;
+static UiController *g_ui;
+static InputManager *g_input;
+
+void setUp()
+{
+  FakeBoard::reset();
+  g_sink = new RecordingSink();
+  g_ui = new UiController(*g_sink);
+  g_input = new InputManager();
+  g_sink->ui = g_ui;
+  g_ui->begin();
+  g_ui->setSleepHoldMs(SLEEP_HOLD_MS);
+  g_ui->power().setTimeouts(IDLE_MS, HIBERNATE_MS, SLEEP_MS);
+  g_ui->power().begin(g_sink->batteryMv());
+}
+
+void tearDown()
+{
+  delete g_input;
+  delete g_ui;
+  delete g_sink;
+}
+
+// One pass of the firmware's ioTask() loop, which also beats its heartbeat
+// and logs the button edges
+static void poll()
+{
+  g_input->update();
+  g_ui->poll(*g_input, Hal::usbConnected(), POLL_MS);
+}
+
+// Polls up to ms; deep sleep does not return on the device, so stops there
+static void runUntil(uint32_t ms)
+{
+  while (Hal::millis() < ms && g_sink->deepSleeps == 0)
+  {
+    poll();
+  }
+}
+
+// First refresh published at or after ms, nullptr when none
+static const Refresh *refreshAfter(uint32_t ms)
+{
+  for (const Refresh &r : g_sink->refreshes)
+  {
+    if (r.atMs >= ms) return &r;
+  }
+  return nullptr;
+}
+
+static void test_merge_requests()
+{
+  TEST_ASSERT_EQUAL(DISPLAY_FILES, UiController::merge(DISPLAY_NONE, DISPLAY_FILES));
+  TEST_ASSERT_EQUAL(DISPLAY_INITIAL, UiController::merge(DISPLAY_FILES, DISPLAY_TEXT));
+  TEST_ASSERT_EQUAL(DISPLAY_IMAGE, UiController::merge(DISPLAY_IMAGE, DISPLAY_TEXT));
+  TEST_ASSERT_EQUAL(DISPLAY_IMAGE, UiController::merge(DISPLAY_TEXT, DISPLAY_IMAGE));
+  TEST_ASSERT_EQUAL(DISPLAY_SLEEP, UiController::merge(DISPLAY_SLEEP, DISPLAY_IMAGE));
+  TEST_ASSERT_EQUAL(DISPLAY_SLEEP, UiController::merge(DISPLAY_FILES, DISPLAY_SLEEP));
+}
+
+// Right pages the list on press and redraws the buttons on release, once
+// the page refresh is done
+static void test_press_pages_then_redraws_buttons()
+{
+  g_input->hold(InputManager::BTN_RIGHT, 1000, 100);
+  runUntil(3000);
+
+  TEST_ASSERT_EQUAL(2, g_sink->refreshes.size());
+  const Refresh &page = g_sink->refreshes[0];
+  const Refresh &buttons = g_sink->refreshes[1];
+  TEST_ASSERT_EQUAL(DISPLAY_FILES, page.cmd);
+  TEST_ASSERT_EQUAL_UINT32(5, page.fileTop);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(POLL_MS, page.atMs - 1000);
+  TEST_ASSERT_EQUAL(DISPLAY_TEXT, buttons.cmd);
+  TEST_ASSERT_EQUAL_UINT32(page.atMs + PARTIAL_MS, buttons.atMs);
+}
+
+// Holding Right scrolls with repeats faster than the panel refreshes: the
+// requests merge into one refresh per partial refresh time, the last one
+// shows where the scroll stopped, and no button redraw follows the burst
+static void test_scroll_burst_coalesces()
+{
+  g_input->hold(InputManager::BTN_RIGHT, 1000, 3000);
+  runUntil(8000);
+
+  size_t n = g_sink->refreshes.size();
+  TEST_ASSERT_TRUE(n >= 3);
+  TEST_ASSERT_TRUE(n <= 3000 / PARTIAL_MS + 2);
+  for (size_t i = 1; i < n; i++)
+  {
+    TEST_ASSERT_EQUAL(DISPLAY_FILES, g_sink->refreshes[i].cmd);
+    TEST_ASSERT_TRUE(g_sink->refreshes[i].atMs - g_sink->refreshes[i - 1].atMs >= PARTIAL_MS);
+  }
+  const Refresh &last = g_sink->refreshes[n - 1];
+  TEST_ASSERT_EQUAL_UINT32(g_ui->state().fileTop, last.fileTop);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(PARTIAL_MS + POLL_MS, last.atMs - 4000);
+}
+
+// Double Back jumps back to the first page
+static void test_double_back_returns_to_first_page()
+{
+  g_input->hold(InputManager::BTN_RIGHT, 1000, 100);
+  g_input->hold(InputManager::BTN_BACK, 3000, 100);
+  g_input->hold(InputManager::BTN_BACK, 3200, 100);
+  runUntil(6000);
+
+  TEST_ASSERT_EQUAL_UINT32(0, g_ui->state().fileTop);
+  const Refresh &last = g_sink->refreshes.back();
+  TEST_ASSERT_EQUAL(DISPLAY_FILES, last.cmd);
+  TEST_ASSERT_EQUAL_UINT32(0, last.fileTop);
+}
+
+// Up + Down in the viewer forces a full refresh of the image without
+// toggling the decode mode, which a lone Up tap does
+static void test_chord_forces_full_refresh_in_viewer()
+{
+  g_input->hold(InputManager::BTN_CONFIRM, 1000, 100);
+  uint8_t chord = 1 << InputManager::BTN_UP | 1 << InputManager::BTN_DOWN;
+  g_input->at(4000, chord);
+  g_input->at(4300, 0);
+  runUntil(7000);
+
+  TEST_ASSERT_TRUE(g_ui->state().viewerActive);
+  TEST_ASSERT_EQUAL(1, g_sink->fullRefreshes);
+  TEST_ASSERT_EQUAL(ImageViewer::MODE_STREAM, g_ui->state().viewerMode);
+  const Refresh *image = refreshAfter(4000);
+  TEST_ASSERT_NOT_NULL(image);
+  TEST_ASSERT_EQUAL(DISPLAY_IMAGE, image->cmd);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(POLL_MS, image->atMs - 4000);
+
+  g_input->hold(InputManager::BTN_UP, 8000, 100);
+  runUntil(10000);
+  TEST_ASSERT_EQUAL(ImageViewer::MODE_BUFFERED, g_ui->state().viewerMode);
+  TEST_ASSERT_EQUAL(1, g_sink->fullRefreshes);
+}
+
+// Without input the stages follow the timeouts: light sleep between polls,
+// then the panel hibernates, then the sleep screen and deep sleep
+static void test_idle_stages()
+{
+  runUntil(IDLE_MS - POLL_MS);
+  TEST_ASSERT_EQUAL(POWER_ACTIVE, g_ui->power().stage());
+  TEST_ASSERT_EQUAL_UINT32(0, FakeBoard::lightSleeps());
+
+  runUntil(IDLE_MS + 2 * POLL_MS);
+  TEST_ASSERT_EQUAL(POWER_IDLE, g_ui->power().stage());
+  TEST_ASSERT_TRUE(FakeBoard::lightSleeps() > 0);
+  TEST_ASSERT_EQUAL(0, g_sink->hibernations);
+
+  runUntil(HIBERNATE_MS + 2 * POLL_MS);
+  TEST_ASSERT_EQUAL(POWER_HIBERNATE, g_ui->power().stage());
+  TEST_ASSERT_EQUAL(1, g_sink->hibernations);
+  TEST_ASSERT_EQUAL(0, g_sink->deepSleeps);
+
+  runUntil(SLEEP_MS + 2 * POLL_MS);
+  TEST_ASSERT_EQUAL(POWER_DEEP_SLEEP, g_ui->power().stage());
+  TEST_ASSERT_EQUAL(1, g_sink->deepSleeps);
+  TEST_ASSERT_EQUAL(DISPLAY_SLEEP, g_sink->refreshes.back().cmd);
+  TEST_ASSERT_EQUAL(1, g_sink->hibernations);
+}
+
+// USB power holds the active stage, light sleep would drop the serial link
+static void test_usb_holds_active()
+{
+  FakeBoard::setUsb(true);
+  runUntil(HIBERNATE_MS + POLL_MS);
+  TEST_ASSERT_EQUAL(POWER_ACTIVE, g_ui->power().stage());
+  TEST_ASSERT_EQUAL_UINT32(0, FakeBoard::lightSleeps());
+}
+
+// Only the power button wakes the chip from light sleep: a short tap on a
+// ladder button must still fall on a poll, whatever its phase against the
+// sleeps, and bring the device back to active
+static void test_idle_tap_is_seen()
+{
+  const uint32_t TAP_MS = 80;
+  const uint32_t GAP_MS = IDLE_MS + 5000; // Back to idle between taps
+  for (uint32_t phase = 0; phase < POLL_MS; phase += 7)
+  {
+    g_input->hold(InputManager::BTN_LEFT, GAP_MS * (phase / 7 + 1) + phase, TAP_MS);
+  }
+
+  for (uint32_t phase = 0; phase < POLL_MS; phase += 7)
+  {
+    uint32_t at = GAP_MS * (phase / 7 + 1) + phase;
+    runUntil(at - POLL_MS);
+    TEST_ASSERT_EQUAL(POWER_IDLE, g_ui->power().stage());
+    uint32_t sleeps = FakeBoard::lightSleeps();
+    runUntil(at + 2 * POLL_MS);
+    const Refresh *page = refreshAfter(at);
+    TEST_ASSERT_NOT_NULL(page);
+    TEST_ASSERT_EQUAL(DISPLAY_FILES, page->cmd);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(POLL_MS + 1, page->atMs - at);
+    TEST_ASSERT_EQUAL(POWER_ACTIVE, g_ui->power().stage());
+    TEST_ASSERT_TRUE(FakeBoard::lightSleeps() > sleeps);
+  }
+}
+
+// A power button hold past sleep_ms sends the device to sleep on release,
+// the sleep screen skips the render queue; a shorter one does not
+static void test_power_hold_sleeps()
+{
+  g_input->hold(InputManager::BTN_POWER, 1000, SLEEP_HOLD_MS / 2);
+  runUntil(3000);
+  TEST_ASSERT_EQUAL(0, g_sink->deepSleeps);
+
+  g_input->hold(InputManager::BTN_RIGHT, 4000, 100);
+  g_input->hold(InputManager::BTN_POWER, 4050, SLEEP_HOLD_MS + 200);
+  runUntil(7000);
+  TEST_ASSERT_EQUAL(1, g_sink->deepSleeps);
+  const Refresh *sleep = refreshAfter(4050 + SLEEP_HOLD_MS + 200);
+  TEST_ASSERT_NOT_NULL(sleep);
+  TEST_ASSERT_EQUAL(DISPLAY_SLEEP, sleep->cmd);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(POLL_MS, sleep->atMs - (4050 + SLEEP_HOLD_MS + 200));
+  TEST_ASSERT_EQUAL(POWER_DEEP_SLEEP, g_ui->power().stage());
+}
+
+// With the snapshot ring full at release the sleep screen is published once
+// it has room, and deep sleep waits for its refresh
+static void test_sleep_waits_for_sleep_screen()
+{
+  const uint32_t RELEASE_MS = 1000 + SLEEP_HOLD_MS + 200;
+  g_input->hold(InputManager::BTN_POWER, 1000, SLEEP_HOLD_MS + 200);
+  g_sink->rejectUntil = RELEASE_MS + 500;
+  runUntil(8000);
+
+  TEST_ASSERT_EQUAL(1, g_sink->deepSleeps);
+  const Refresh *sleep = refreshAfter(RELEASE_MS);
+  TEST_ASSERT_NOT_NULL(sleep);
+  TEST_ASSERT_EQUAL(DISPLAY_SLEEP, sleep->cmd);
+  TEST_ASSERT_TRUE(sleep->atMs >= g_sink->rejectUntil);
+  TEST_ASSERT_TRUE(g_sink->deepSleepAtMs >= sleep->atMs + FULL_MS);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(UiController::SLEEP_SCREEN_TIMEOUT_MS, g_sink->deepSleepAtMs - RELEASE_MS);
+}
+
+// A render task that never takes the sleep screen only delays deep sleep by
+// the timeout
+static void test_sleep_times_out_without_render()
+{
+  const uint32_t RELEASE_MS = 1000 + SLEEP_HOLD_MS + 200;
+  g_input->hold(InputManager::BTN_POWER, 1000, SLEEP_HOLD_MS + 200);
+  g_sink->rejectUntil = 60000;
+  runUntil(8000);
+
+  TEST_ASSERT_EQUAL(1, g_sink->deepSleeps);
+  TEST_ASSERT_NULL(refreshAfter(RELEASE_MS));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(UiController::SLEEP_SCREEN_TIMEOUT_MS + POLL_MS,
+                                   g_sink->deepSleepAtMs - RELEASE_MS);
+  TEST_ASSERT_TRUE(g_sink->deepSleepAtMs - RELEASE_MS >= UiController::SLEEP_SCREEN_TIMEOUT_MS);
+}
+
+// A long Confirm asks for an index rebuild instead of opening the viewer
+static void test_long_confirm_rebuilds_index()
+{
+  g_input->hold(InputManager::BTN_CONFIRM, 1000, 1200);
+  runUntil(4000);
+  TEST_ASSERT_EQUAL(1, g_sink->rebuilds);
+  TEST_ASSERT_FALSE(g_ui->state().viewerActive);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_merge_requests);
+  RUN_TEST(test_press_pages_then_redraws_buttons);
+  RUN_TEST(test_scroll_burst_coalesces);
+  RUN_TEST(test_double_back_returns_to_first_page);
+  RUN_TEST(test_chord_forces_full_refresh_in_viewer);
+  RUN_TEST(test_idle_stages);
+  RUN_TEST(test_usb_holds_active);
+  RUN_TEST(test_idle_tap_is_seen);
+  RUN_TEST(test_power_hold_sleeps);
+  RUN_TEST(test_sleep_waits_for_sleep_screen);
+  RUN_TEST(test_sleep_times_out_without_render);
+  RUN_TEST(test_long_confirm_rebuilds_index);
+  return UNITY_END();
+}
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""Compare benchmark results captured from the firmware serial log.
+
+Each log is scanned for the JSON line printed by the "bench" serial command
+(starting with {"benchmark":), or the output of the native_bench host build,
+which prints the same line. The last run of each log is used.
+
+Usage: bench_compare.py baseline.log candidate.log [--threshold 5]
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    run = None
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith('{"benchmark":'):
+                run = json.loads(line)
+    if run is None:
+        sys.exit(f"{path}: no benchmark output found")
+    return run
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("--threshold", type=float, default=5.0, help="regression threshold in percent")
+    args = parser.parse_args()
+
+    base = load(args.baseline)
+    cand = load(args.candidate)
+    base_results = {r["name"]: r for r in base["results"]}
+
+    print(f"baseline:  {base['benchmark']['build']}")
+    print(f"candidate: {cand['benchmark']['build']}")
+    print(f"{'case':28} {'base us':>10} {'cand us':>10} {'delta':>8}")
+
+    regressions = 0
+    for r in cand["results"]:
+        b = base_results.get(r["name"])
+        if b is None:
+            print(f"{r['name']:28} {'-':>10} {r['mean_us']:>10} {'new':>8}")
+            continue
+        delta = (r["mean_us"] - b["mean_us"]) * 100.0 / max(b["mean_us"], 1)
+        flag = ""
+        if delta > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{r['name']:28} {b['mean_us']:>10} {r['mean_us']:>10} {delta:>+7.1f}%{flag}")
+
+    sys.exit(1 if regressions else 0)
+
+
+if __name__ == "__main__":
+    main()
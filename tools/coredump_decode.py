@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+"""Read the core dump partition from a device and print the crash report.
+
+Reads the "coredump" partition (0xFF0000, 64KB) with esptool and decodes it
+against the firmware ELF with esp-coredump (pip install esp-coredump).
+The "health" serial command shows whether a core dump is present;
+"health erase-coredump" clears it after decoding.
+
+Usage: coredump_decode.py --port COM4 [--elf .pio/build/esp32-c3-devkitm-1/firmware.elf]
+       coredump_decode.py --dump coredump.bin [--elf ...]
+"""
+
+import argparse
+import subprocess
+import sys
+import tempfile
+
+COREDUMP_OFFSET = 0xFF0000
+COREDUMP_SIZE = 0x10000
+DEFAULT_ELF = ".pio/build/esp32-c3-devkitm-1/firmware.elf"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="serial port of the device to read the partition from")
+    source.add_argument("--dump", help="use an existing partition dump instead of reading the device")
+    parser.add_argument("--elf", default=DEFAULT_ELF)
+    args = parser.parse_args()
+
+    dump = args.dump
+    if dump is None:
+        dump = tempfile.NamedTemporaryFile(suffix=".bin", delete=False).name
+        subprocess.run([sys.executable, "-m", "esptool", "--chip", "esp32c3", "--port", args.port, "read_flash",
+                        hex(COREDUMP_OFFSET), hex(COREDUMP_SIZE), dump], check=True)
+
+    with open(dump, "rb") as f:
+        if f.read(4) == b"\xff\xff\xff\xff":
+            sys.exit("No core dump in partition")
+
+    subprocess.run([sys.executable, "-m", "esp_coredump", "--chip", "esp32c3", "info_corefile", "--core", dump,
+                    "--core-format", "raw", args.elf], check=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Decode the firmware binary event log into text.
+
+Dump the "eventlog" partition first (address and size are printed by the
+"log" serial command):
+
+    esptool.py read_flash 0xFD0000 0x20000 eventlog.bin
+
+Event names and formats are read from the EventId enum in src/EventLog.h so
+the decoder always matches the firmware.
+
+Usage: eventlog_decode.py eventlog.bin [--header src/EventLog.h]
+"""
+
+import argparse
+import os
+import re
+import struct
+
+SECTOR_SIZE = 4096
+SECTOR_MAGIC = 0x4C453458
+HEADER_SIZE = 16
+DEFAULT_HEADER = os.path.join(os.path.dirname(__file__), "..", "src", "EventLog.h")
+EVT_BOOT = 1
+
+
+def load_formats(path):
+    formats = {}
+    pattern = re.compile(r"^\s*(EVT_\w+)\s*=\s*(\d+),\s*//\s*(.*)$")
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            m = pattern.match(line)
+            if m:
+                formats[int(m.group(2))] = (m.group(1), m.group(3).strip())
+    return formats
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(data):
+            raise IndexError("truncated varint")
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if b < 0x80:
+            return value, pos
+
+
+def decode_sector(data, formats):
+    magic, seq, start_ms, _ = struct.unpack_from("<IIII", data)
+    clock = start_ms
+    pos = HEADER_SIZE
+    events = []
+    while pos < len(data) and data[pos] != 0xFF:
+        head = data[pos]
+        pos += 1
+        event_id = head & 0x3F
+        argc = head >> 6
+        try:
+            dt, pos = read_varint(data, pos)
+            args = []
+            for _ in range(argc):
+                arg, pos = read_varint(data, pos)
+                args.append(arg)
+        except IndexError:
+            events.append((clock, "<truncated record>"))
+            break
+        clock = dt if event_id == EVT_BOOT else clock + dt
+        name, fmt = formats.get(event_id, (f"EVT_{event_id}", " ".join("{}" for _ in args)))
+        try:
+            text = fmt.format(*args)
+        except IndexError:
+            text = f"{fmt} {args}"
+        events.append((clock, f"{name:18} {text}"))
+    return seq, events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump")
+    parser.add_argument("--header", default=DEFAULT_HEADER)
+    args = parser.parse_args()
+
+    formats = load_formats(args.header)
+    with open(args.dump, "rb") as f:
+        image = f.read()
+
+    sectors = []
+    for offset in range(0, len(image) - HEADER_SIZE, SECTOR_SIZE):
+        data = image[offset:offset + SECTOR_SIZE]
+        if struct.unpack_from("<I", data)[0] == SECTOR_MAGIC:
+            sectors.append(decode_sector(data, formats))
+
+    # Oldest sector first; sequence numbers only grow
+    for seq, events in sorted(sectors, key=lambda s: s[0]):
+        print(f"-- sector seq {seq}")
+        for ms, text in events:
+            print(f"{ms / 1000.0:12.3f}  {text}")
+
+
+if __name__ == "__main__":
+    main()
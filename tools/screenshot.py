@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""Capture the panel contents from the firmware "screenshot" serial command.
+
+Either talks to the device directly (needs pyserial) or reads a captured
+serial log, decodes the PackBits bands and writes a PNG in screen
+orientation (480x800 portrait, as drawn with display.setRotation(3)).
+
+Usage: screenshot.py out.png --port COM4 [--native]
+       screenshot.py out.png --log serial.log [--native]
+"""
+
+import argparse
+import base64
+import re
+import sys
+import time
+
+from PIL import Image
+
+BEGIN_RE = re.compile(r"SCREENSHOT BEGIN width=(\d+) height=(\d+) rotation=(\d+) seq=(\d+) writes=(\d+)")
+END_RE = re.compile(r"SCREENSHOT END raw=(\d+) packed=(\d+) ms=(\d+) seq=(\d+) writes=(\d+)")
+
+
+def unpackbits(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        n = data[i]
+        i += 1
+        if n < 128:
+            out += data[i:i + n + 1]
+            i += n + 1
+        else:
+            out += bytes([data[i]]) * (257 - n)
+            i += 1
+    return bytes(out)
+
+
+def parse(lines):
+    """Return the last complete dump in lines as (header, bands, trailer)."""
+    result = None
+    header = None
+    bands = []
+    for line in lines:
+        line = line.strip()
+        m = BEGIN_RE.search(line)
+        if m:
+            header = tuple(int(v) for v in m.groups())
+            bands = []
+            continue
+        if header is None:
+            continue
+        m = END_RE.search(line)
+        if m:
+            result = (header, bands, tuple(int(v) for v in m.groups()))
+            header = None
+        elif line:
+            bands.append(line)
+    return result
+
+
+def read_device(port, timeout):
+    import serial
+
+    with serial.Serial(port, 115200, timeout=1) as ser:
+        ser.reset_input_buffer()
+        ser.write(b"screenshot\n")
+        lines = []
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            line = ser.readline().decode("ascii", errors="replace")
+            if line:
+                lines.append(line)
+                if END_RE.search(line):
+                    break
+        return lines
+
+
+def decode(dump):
+    (width, height, rotation, seq, writes), bands, (raw, packed, ms, end_seq, end_writes) = dump
+    frame = bytearray()
+    packed_lines = 0
+    for band in bands:
+        data = base64.b64decode(band)
+        packed_lines += len(band) + 2  # CRLF
+        frame += unpackbits(data)
+    if len(frame) != raw or len(frame) != width * height // 8:
+        sys.exit(f"corrupt dump: {len(frame)} bytes, expected {raw}")
+
+    # Panel RAM: 1 = white, MSB first, native orientation
+    img = Image.frombytes("1", (width, height), bytes(frame))
+    stats = {
+        "ratio": raw / max(packed, 1),
+        "throughput": packed_lines * 1000 / max(ms, 1),
+        "ms": ms,
+        # Refreshed, or written (e.g. a streamed frame) while dumping
+        "torn": seq != end_seq or writes != end_writes,
+    }
+    return img, rotation, stats
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("output")
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="serial port of the device")
+    source.add_argument("--log", help="captured serial log containing a dump")
+    parser.add_argument("--native", action="store_true", help="keep native 800x480 panel orientation")
+    parser.add_argument("--retries", type=int, default=3, help="re-capture torn frames (--port only)")
+    args = parser.parse_args()
+
+    for attempt in range(args.retries if args.port else 1):
+        if args.port:
+            lines = read_device(args.port, 30)
+        else:
+            with open(args.log, encoding="utf-8", errors="replace") as f:
+                lines = f.readlines()
+        dump = parse(lines)
+        if dump is None:
+            sys.exit("no complete screenshot found")
+        img, rotation, stats = decode(dump)
+        if not stats["torn"]:
+            break
+        print("frame changed during the dump" + (", retrying" if args.port else ""), file=sys.stderr)
+
+    if not args.native and rotation == 3:
+        # Inverse of the rotation applied by tools/x4i_convert.py
+        img = img.rotate(-90, expand=True)
+    img.save(args.output)
+
+    print(f"{args.output}: {img.width}x{img.height}, compression {stats['ratio']:.1f}x, "
+          f"{stats['ms']} ms on device, {stats['throughput'] / 1024:.1f} KB/s serial")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Convert an image to the .x4i frame format read by the firmware image viewer.
+
+The input is scaled to the 480x800 portrait screen, rotated into native panel
+orientation (800x480, matching display.setRotation(3)) and written as 1 or 2
+bits per pixel, optionally PackBits compressed.
+
+Usage: x4i_convert.py input.png output.x4i [--bpp 1|2] [--raw]
+"""
+
+import argparse
+import struct
+
+from PIL import Image
+
+SCREEN_W, SCREEN_H = 480, 800  # Portrait, as drawn by the firmware
+
+
+def packbits(data):
+    out = bytearray()
+    i = 0
+    n = len(data)
+    while i < n:
+        # Repeat run
+        run = 1
+        while i + run < n and run < 128 and data[i + run] == data[i]:
+            run += 1
+        if run >= 2:
+            out.append(257 - run)
+            out.append(data[i])
+            i += run
+            continue
+        # Literal run, stops before the next repeat of 2+ bytes
+        start = i
+        while i < n and i - start < 128:
+            if i + 1 < n and data[i] == data[i + 1]:
+                break
+            i += 1
+        out.append(i - start - 1)
+        out += data[start:i]
+    return bytes(out)
+
+
+def pack_pixels(img, bpp):
+    levels = (1 << bpp) - 1
+    w, h = img.size
+    px = img.load()
+    out = bytearray()
+    for y in range(h):
+        acc = 0
+        bits = 0
+        for x in range(w):
+            acc = (acc << bpp) | (px[x, y] * levels + 127) // 255
+            bits += bpp
+            if bits == 8:
+                out.append(acc)
+                acc = 0
+                bits = 0
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input")
+    parser.add_argument("output")
+    parser.add_argument("--bpp", type=int, choices=(1, 2), default=1)
+    parser.add_argument("--raw", action="store_true", help="store uncompressed")
+    args = parser.parse_args()
+
+    img = Image.open(args.input).convert("L")
+    img.thumbnail((SCREEN_W, SCREEN_H))
+    canvas = Image.new("L", (SCREEN_W, SCREEN_H), 255)
+    canvas.paste(img, ((SCREEN_W - img.width) // 2, (SCREEN_H - img.height) // 2))
+    if args.bpp == 1:
+        canvas = canvas.convert("1").convert("L")
+
+    native = canvas.rotate(90, expand=True)
+    payload = pack_pixels(native, args.bpp)
+    compression = 0 if args.raw else 1
+    if compression:
+        payload = packbits(payload)
+
+    header = b"X4IM" + struct.pack("<BBBBHHI", 1, args.bpp, compression, 0, native.width, native.height, len(payload))
+    with open(args.output, "wb") as f:
+        f.write(header)
+        f.write(payload)
+    print(f"{args.output}: {native.width}x{native.height} {args.bpp}bpp, {len(payload)} payload bytes")
+
+
+if __name__ == "__main__":
+    main()